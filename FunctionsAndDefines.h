@@ -6,69 +6,101 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 #define FUNCTIONS_AND_DEFINES
 #define SMB2 0
 
 #define SMBD 1
 
-inline uint32_t readBigInt(FILE *file) {
-	uint32_t c1 = getc(file) << 24;
-	uint32_t c2 = getc(file) << 16;
-	uint32_t c3 = getc(file) << 8;
-	uint32_t c4 = getc(file);
-	return (c1 | c2 | c3 | c4);
-}
+// Byte order of the machine, so reads/writes in the same order become a single load/store
+// and the other order becomes a load/store plus a byte swap
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define HOST_LITTLE_ENDIAN
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BIG_ENDIAN
+#endif
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#define BYTE_SWAP_32(value) _byteswap_ulong(value)
+#elif defined(__GNUC__)
+#define BYTE_SWAP_32(value) __builtin_bswap32(value)
+#endif
 
-inline uint32_t readLittleInt(FILE *file) {
-	uint32_t c1 = getc(file);
-	uint32_t c2 = getc(file) << 8;
-	uint32_t c3 = getc(file) << 16;
-	uint32_t c4 = getc(file) << 24;
-	return (c1 | c2 | c3 | c4);
+// All of the following read/write at an offset into a memory buffer
+// The caller makes sure the buffer is big enough
+
+inline uint32_t readBigIntData(const uint8_t* data, uint32_t offset) {
+#if (defined(HOST_LITTLE_ENDIAN) && defined(BYTE_SWAP_32)) || defined(HOST_BIG_ENDIAN)
+	uint32_t value;
+	memcpy(&value, &data[offset], sizeof(uint32_t));
+#ifdef HOST_LITTLE_ENDIAN
+	value = BYTE_SWAP_32(value);
+#endif
+	return value;
+#else
+	return ((uint32_t)data[offset] << 24) | ((uint32_t)data[offset + 1] << 16) | ((uint32_t)data[offset + 2] << 8) | (uint32_t)data[offset + 3];
+#endif
 }
 
-inline uint16_t readBigShort(FILE *file) {
-	uint16_t c1 = (uint16_t)getc(file) << 8;
-	uint16_t c2 = (uint16_t)getc(file);
-	return (uint16_t)(c1 | c2);
+inline uint32_t readLittleIntData(const uint8_t* data, uint32_t offset) {
+#if defined(HOST_LITTLE_ENDIAN) || (defined(HOST_BIG_ENDIAN) && defined(BYTE_SWAP_32))
+	uint32_t value;
+	memcpy(&value, &data[offset], sizeof(uint32_t));
+#ifdef HOST_BIG_ENDIAN
+	value = BYTE_SWAP_32(value);
+#endif
+	return value;
+#else
+	return (uint32_t)data[offset] | ((uint32_t)data[offset + 1] << 8) | ((uint32_t)data[offset + 2] << 16) | ((uint32_t)data[offset + 3] << 24);
+#endif
 }
 
-inline uint16_t readLittleShort(FILE *file) {
-	uint16_t c1 = (uint16_t)getc(file);
-	uint16_t c2 = (uint16_t)getc(file) << 8;
-	return (uint16_t)(c1 | c2);
+inline uint16_t readBigShortData(const uint8_t* data, uint32_t offset) {
+	return (uint16_t)((data[offset] << 8) | data[offset + 1]);
 }
 
-inline void writeBigInt(FILE *file, uint32_t value) {
-	putc((value >> 24), file);
-	putc((value >> 16), file);
-	putc((value >> 8), file);
-	putc((value), file);
+inline uint16_t readLittleShortData(const uint8_t* data, uint32_t offset) {
+	return (uint16_t)(data[offset] | (data[offset + 1] << 8));
 }
 
-inline void writeLittleIntData(uint8_t* data, int offset, uint32_t num) {
-	data[offset] = (uint8_t)(num);
-	data[offset + 1] = (uint8_t)(num >> 8);
-	data[offset + 2] = (uint8_t)(num >> 16);
-	data[offset + 3] = (uint8_t)(num >> 24);
+inline void writeBigIntData(uint8_t* data, uint32_t offset, uint32_t value) {
+#if (defined(HOST_LITTLE_ENDIAN) && defined(BYTE_SWAP_32)) || defined(HOST_BIG_ENDIAN)
+#ifdef HOST_LITTLE_ENDIAN
+	value = BYTE_SWAP_32(value);
+#endif
+	memcpy(&data[offset], &value, sizeof(uint32_t));
+#else
+	data[offset] = (uint8_t)(value >> 24);
+	data[offset + 1] = (uint8_t)(value >> 16);
+	data[offset + 2] = (uint8_t)(value >> 8);
+	data[offset + 3] = (uint8_t)(value);
+#endif
 }
 
-inline void writeLittleInt(FILE *file, uint32_t value) {
-	putc((value), file);
-	putc((value >> 8), file);
-	putc((value >> 16), file);
-	putc((value >> 24), file);
+inline void writeLittleIntData(uint8_t* data, uint32_t offset, uint32_t value) {
+#if defined(HOST_LITTLE_ENDIAN) || (defined(HOST_BIG_ENDIAN) && defined(BYTE_SWAP_32))
+#ifdef HOST_BIG_ENDIAN
+	value = BYTE_SWAP_32(value);
+#endif
+	memcpy(&data[offset], &value, sizeof(uint32_t));
+#else
+	data[offset] = (uint8_t)(value);
+	data[offset + 1] = (uint8_t)(value >> 8);
+	data[offset + 2] = (uint8_t)(value >> 16);
+	data[offset + 3] = (uint8_t)(value >> 24);
+#endif
 }
 
-inline void writeBigShort(FILE *file, uint16_t value) {
-	putc((value >> 8), file);
-	putc((value), file);
+inline void writeBigShortData(uint8_t* data, uint32_t offset, uint16_t value) {
+	data[offset] = (uint8_t)(value >> 8);
+	data[offset + 1] = (uint8_t)(value);
 }
 
-inline void writeLittleShort(FILE *file, uint16_t value) {
-	putc((value), file);
-	putc((value >> 8), file);
+inline void writeLittleShortData(uint8_t* data, uint32_t offset, uint16_t value) {
+	data[offset] = (uint8_t)(value);
+	data[offset + 1] = (uint8_t)(value >> 8);
 }
 
 #endif // !FUNCTIONS_AND_DEFINES
\ No newline at end of file
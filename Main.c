@@ -8,38 +8,13 @@
 #include <string.h>
 
 #include "lzss.h"
+#include "lzssformat.h"
+#include "jobs.h"
+#include "server.h"
 
-inline uint32_t readInt(FILE* file) {
-	uint32_t c1 = (uint32_t)(getc(file));
-	uint32_t c2 = (uint32_t)(getc(file) << 8);
-	uint32_t c3 = (uint32_t)(getc(file) << 16);
-	uint32_t c4 = (uint32_t)(getc(file) << 24);
-	return (c1 | c2 | c3 | c4);
-}
-
-inline uint16_t readShort(FILE* file) {
-	uint32_t c1 = (uint32_t)(getc(file) << 8);
-	uint32_t c2 = (uint32_t)(getc(file));
-	return (uint16_t)(c1 | c2);
-}
-
-inline uint32_t readIntData(char* data, int offset) {
-	return (uint32_t)((data[offset] << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) + (data[offset + 3]));
-}
-
-inline void writeLittleIntData(uint8_t* data, int offset, uint32_t num) {
-	data[offset] = (uint8_t)(num);
-	data[offset + 1] = (uint8_t)(num >> 8);
-	data[offset + 2] = (uint8_t)(num >> 16);
-	data[offset + 3] = (uint8_t)(num >> 24);
-}
-
-inline void writeLittleInt(FILE* file, uint32_t num) {
-	putc((uint8_t)(num), file);
-	putc((uint8_t)(num >> 8), file);
-	putc((uint8_t)(num >> 16), file);
-	putc((uint8_t)(num >> 24), file);
-}
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 typedef struct {
 	uint32_t length;
@@ -47,7 +22,65 @@ typedef struct {
 }ReferenceBlock;
 
 
-void decompress(char* filename);
+// Window used for references before the start of the file (zeros, or zeros followed by a dictionary)
+// Every --dict loads a window of its own, so the files before it keep theirs
+static uint8_t zeroWindow[Format::windowSize];
+static const uint8_t* dictionaryWindow = zeroWindow;
+static uint32_t dictionaryWindowSize = 0;
+
+// Dictionaries and base files loaded so far, freed at the end (jobs point into them)
+static void** loadedBuffers = NULL;
+static int loadedBufferCount = 0;
+
+// Header format of files to decompress
+static int headerFormat = LZ_FORMAT_SMB;
+
+// Whether compressed files are decoded in memory and compared against the input
+static int verify = 0;
+
+// Whether compressed files are decompressed and compressed again in place (kept if it isn't smaller)
+static int transcode = 0;
+
+// Whether files are compressed to the smallest size instead of quickly
+static int optimal = 0;
+
+// Whether every file is compressed with all the strategies at once, keeping the smallest
+static int best = 0;
+
+// Files estimated to compress worse than this ratio are stored as literals, or skipped (0 to compress everything)
+static double probeRatio = 0;
+static int probeSkip = 0;
+
+// Whether compressed files are only decoded in memory and listed with a checksum
+static int check = 0;
+
+// Whether files to compress only get their compressed size listed, and if it is the fast estimate
+static int estimate = 0;
+static int estimateFast = 0;
+
+// Whether a seek index is written next to every compressed file
+static int writeIndex = 0;
+
+// Previous version of the files to compress, and it compressed
+static uint8_t* baseData = NULL;
+static uint32_t baseSize = 0;
+static uint8_t* baseCompressed = NULL;
+static uint32_t baseCompressedSize = 0;
+
+// Memory budget in bytes for running files in parallel (0 for no budget)
+static uint64_t maxMemory = 0;
+
+// Socket to answer requests on, or to send the files to instead of handling them here
+static const char* serverSocket = NULL;
+static const char* clientSocket = NULL;
+
+int loadDictionary(char* filename);
+
+void addJob(Job* jobs, int* jobCount, char* filename, int type);
+
+void setJobOptions(Job* job);
+
+void keepBuffer(void* buffer);
 
 //void compress(char* filename);
 
@@ -55,30 +88,187 @@ void decompress(char* filename);
 
 int main(int argc, char* argv[]) {
 	if (argc <= 1) {
-		printf("Add lz paths as command line params");
+		printf("Add lz paths as command line params\n");
+		printf("Use --dict [FILE] before any files to compress/decompress them with a dictionary\n");
+		printf("Use --verify before any files to check that compressed files decompress back to the input\n");
+		printf("Use --transcode before any files to compress .lz files again in memory, replacing them if smaller\n");
+		printf("Use --optimal before any files to compress them as small as possible (much slower, for final builds)\n");
+		printf("Use --best before any files to compress them with every strategy at once and keep the smallest\n");
+		printf("Use --probe [store|skip] [RATIO] before any files to store or skip files estimated to compress worse than RATIO (ie 0.95)\n");
+		printf("Use --check before any files to decode .lz files in memory and print a CRC-32 manifest without writing anything\n");
+		printf("Use --estimate [exact|fast] before any files to list the size they compress to without writing anything\n");
+		printf("Use --index before any files to write a seek index (.idx) next to every compressed file\n");
+		printf("Use --base [OLD RAW] [OLD LZ] before a file to compress it by reusing the compressed previous version\n");
+		printf("Use --format [auto|smb|ff7] before any files to set the header of files to decompress (default smb)\n");
+		printf("Use --max-memory [MB] before any files to handle them in parallel while their estimated memory fits\n");
+		printf("Use --progress before any files to show a progress bar for all of them\n");
+		printf("Use --serve [SOCKET] after any options to keep answering requests on a Unix socket\n");
+		printf("Use --client [SOCKET] before any files to have the server at the socket handle them\n");
 	}
 
 	//omp_set_num_threads(NUM_THREADS);
 
+	Job* jobs = (Job*)calloc((size_t)argc, sizeof(Job));
+	if (jobs == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+	int jobCount = 0;
+	// Every --dict loads one buffer and every --base two, so there can't be more than the args
+	loadedBuffers = (void**)calloc((size_t)argc, sizeof(void*));
+	if (loadedBuffers == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+
 	// Go through every command line arg
 	for (int i = 1; i < argc; ++i) {
+		// Dictionary for every file after it
+		if (strcmp(argv[i], "--dict") == 0) {
+			if (i + 1 >= argc || loadDictionary(argv[++i]) != 0) {
+				return -1;
+			}
+			continue;
+		}
+		else if (strcmp(argv[i], "--verify") == 0) {
+			verify = 1;
+			continue;
+		}
+		else if (strcmp(argv[i], "--transcode") == 0) {
+			transcode = 1;
+			continue;
+		}
+		else if (strcmp(argv[i], "--progress") == 0) {
+			showJobProgress(1);
+			continue;
+		}
+		else if (strcmp(argv[i], "--optimal") == 0) {
+			optimal = 1;
+			continue;
+		}
+		else if (strcmp(argv[i], "--best") == 0) {
+			best = 1;
+#ifdef _OPENMP
+			// The strategies run in threads of their own under the job's thread
+			omp_set_max_active_levels(2);
+#endif
+			continue;
+		}
+		else if (strcmp(argv[i], "--probe") == 0) {
+			if (i + 2 >= argc) {
+				return -1;
+			}
+			if (strcmp(argv[i + 1], "store") != 0 && strcmp(argv[i + 1], "skip") != 0) {
+				printf("ERROR: Unknown probe action %s (use store or skip)\n", argv[i + 1]);
+				return -1;
+			}
+			probeSkip = strcmp(argv[i + 1], "skip") == 0;
+			probeRatio = atof(argv[i + 2]);
+			if (probeRatio <= 0) {
+				printf("ERROR: Invalid probe ratio %s\n", argv[i + 2]);
+				return -1;
+			}
+			i += 2;
+			continue;
+		}
+		else if (strcmp(argv[i], "--check") == 0) {
+			check = 1;
+			continue;
+		}
+		else if (strcmp(argv[i], "--estimate") == 0) {
+			if (i + 1 >= argc) {
+				return -1;
+			}
+			++i;
+			if (strcmp(argv[i], "exact") != 0 && strcmp(argv[i], "fast") != 0) {
+				printf("ERROR: Unknown estimate %s (use exact or fast)\n", argv[i]);
+				return -1;
+			}
+			estimate = 1;
+			estimateFast = strcmp(argv[i], "fast") == 0;
+			continue;
+		}
+		else if (strcmp(argv[i], "--index") == 0) {
+			writeIndex = 1;
+			continue;
+		}
+		else if (strcmp(argv[i], "--base") == 0) {
+			if (i + 2 >= argc) {
+				return -1;
+			}
+			baseData = loadFile(argv[i + 1], &baseSize);
+			baseCompressed = loadFile(argv[i + 2], &baseCompressedSize);
+			keepBuffer(baseData);
+			keepBuffer(baseCompressed);
+			if (baseData == NULL || baseCompressed == NULL) {
+				return -1;
+			}
+			i += 2;
+			continue;
+		}
+		else if (strcmp(argv[i], "--max-memory") == 0) {
+			if (i + 1 >= argc) {
+				return -1;
+			}
+			maxMemory = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+			if (maxMemory == 0) {
+				printf("ERROR: Invalid memory budget %s\n", argv[i]);
+				return -1;
+			}
+			continue;
+		}
+		else if (strcmp(argv[i], "--serve") == 0 || strcmp(argv[i], "--client") == 0) {
+			if (i + 1 >= argc) {
+				return -1;
+			}
+			if (strcmp(argv[i], "--serve") == 0) {
+				serverSocket = argv[++i];
+			}
+			else {
+				clientSocket = argv[++i];
+			}
+			continue;
+		}
+		else if (strcmp(argv[i], "--format") == 0) {
+			if (i + 1 >= argc) {
+				return -1;
+			}
+			++i;
+			if (strcmp(argv[i], "auto") == 0) {
+				headerFormat = LZ_FORMAT_AUTO;
+			}
+			else if (strcmp(argv[i], "smb") == 0) {
+				headerFormat = LZ_FORMAT_SMB;
+			}
+			else if (strcmp(argv[i], "ff7") == 0) {
+				headerFormat = LZ_FORMAT_FF7;
+			}
+			else {
+				printf("ERROR: Unknown format %s (use auto, smb, or ff7)\n", argv[i]);
+				return -1;
+			}
+			continue;
+		}
+
+		int decompressType = check ? JOB_CHECK : (transcode ? JOB_TRANSCODE : JOB_DECOMPRESS);
+		int compressType = estimate ? JOB_ESTIMATE : JOB_COMPRESS;
 		int strLen = (int)strlen(argv[i]);
 		if (strLen > 0) {
 			char fileCheck = argv[i][strLen - 1];
 			if (fileCheck == 'z') {
-				decompress(argv[i]);
+				addJob(jobs, &jobCount, argv[i], decompressType);
 			}
 			else if (fileCheck == 'w') {
-				compressFile(argv[i]);
+				addJob(jobs, &jobCount, argv[i], compressType);
 			}
 			else {
 				printf("Unable to identify whether to compress or decompress file\nEnter 'D' to decompress, 'C' to compress, or any other character to skip\n");
 				int answer = (char)getc(stdin);
 				if (answer == 'D' || answer == 'd') {
-					decompress(argv[i]);
+					addJob(jobs, &jobCount, argv[i], decompressType);
 				}
 				else if (answer == 'C' || answer == 'c') {
-					compressFile(argv[i]);
+					addJob(jobs, &jobCount, argv[i], compressType);
 				}
 				else {
 					continue;
@@ -86,131 +276,174 @@ int main(int argc, char* argv[]) {
 			}
 		}
 	}
-	return 0;
-}
 
-void decompress(char* filename) {
-	// Try to open it
-	FILE* lz = fopen(filename, "rb");
-	if (lz == NULL) {
-		printf("ERROR: File not found: %s\n", filename);
-		return;
-	}
-	printf("Decompressing %s\n", filename);
-
-	// Create a temp file for the unfixed lz (SMB lz has a slightly different header than FF7 LZS)
-	FILE* normal = tmpfile();
-
-	// Unfix the header (Turn it back into normal FF7 LZSS)
-	int csize = (int)readInt(lz) - 8;
-	// Filesize of the uncompressed data
-	int dataSize = (int)readInt(lz);
-	putc(csize & 0xFF, normal);
-	putc((csize >> 8) & 0xFF, normal);
-	putc((csize >> 16) & 0xFF, normal);
-	putc((csize >> 24) & 0xFF, normal);
-	for (int j = 0; j < (int)(csize); j++) {
-		char c = (char)getc(lz);
-		putc(c, normal);
+	// The server applies the options to every request it gets
+	if (serverSocket != NULL) {
+		Job options;
+		memset(&options, 0, sizeof(options));
+		setJobOptions(&options);
+		// Requests say what they want done with the data
+		options.baseData = NULL;
+		options.baseCompressed = NULL;
+		runServer(serverSocket, &options);
+		free(jobs);
+		return 1;
 	}
-	fclose(lz);
-	fflush(normal);
-	fseek(normal, 0, SEEK_SET);
 
-	// Make the output file name
-	char outfileName[512];
-	sscanf(filename, "%507s", outfileName);
-	{
-		int nameLength = (int)strlen(outfileName);
-		outfileName[nameLength++] = '.';
-		outfileName[nameLength++] = 'r';
-		outfileName[nameLength++] = 'a';
-		outfileName[nameLength++] = 'w';
-		outfileName[nameLength++] = '\0';
+	int failures;
+	if (clientSocket != NULL) {
+		failures = runClient(clientSocket, jobs, jobCount);
+	}
+	else if (maxMemory > 0) {
+		failures = runJobsWithBudget(jobs, jobCount, maxMemory);
+	}
+	else {
+		// Transcoding is all compressing and checking/estimating writes nothing, so every file gets its own thread
+		failures = transcode || check || estimate ? runJobsParallel(jobs, jobCount) : runJobs(jobs, jobCount);
 	}
 
-	// The size the the lzss data + 4 bytes for the header
-	uint32_t filesize = readInt(normal) + 4;
-
-	char * memBlock = (char*)malloc(sizeof(char) * (dataSize));
-	int memPosition = 0;
-
-	// Loop until we reach the end of the data or end of the file
-	while ((unsigned)ftell(normal) < filesize && !feof(normal)) {
-
-		// Read the first control block
-		// Read right to left, each bit specifies how the the next 8 spots of data will be
-		// 0 means write the byte directly to the output
-		// 1 represents there will be reference (2 byte)
-		uint8_t block = (uint8_t)getc(normal);
+	// Checksum, uncompressed size and name of every checked file, in the order they were given
+	for (int i = 0; i < jobCount; i++) {
+		if (jobs[i].type != JOB_CHECK) {
+			continue;
+		}
+		if (jobs[i].failed) {
+			printf("FAILED   %10s %s\n", "", jobs[i].filename);
+		}
+		else {
+			printf("%08x %10u %s\n", jobs[i].checksum, jobs[i].outputSize, jobs[i].filename);
+		}
+	}
 
-		// Go through every bit in the control block
-		for (int j = 0; j < 8 && (unsigned)ftell(normal) < filesize && !feof(normal); ++j) {
-			// Literal byte copy
-			if (block & 0x01) {
-				memBlock[memPosition] = (char)getc(normal);
-				++memPosition;
-			}// Reference
+	// Which strategy won every raced file, and what each one came to
+	if (best && jobCount > 0) {
+		printf("%-8s", "winner");
+		for (int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+			printf(" %10s", strategyName(strategy));
+		}
+		printf(" file\n");
+	}
+	for (int i = 0; i < jobCount; i++) {
+		if (!jobs[i].best || jobs[i].failed || jobs[i].strategySizes[jobs[i].winner] == 0) {
+			continue;
+		}
+		printf("%-8s", strategyName(jobs[i].winner));
+		for (int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+			if (jobs[i].strategySizes[strategy] == 0) {
+				printf(" %10s", "failed");
+			}
 			else {
-				uint16_t reference = readShort(normal);
-
-				// Length is the last four bits + 3
-				// Any less than a lengh of 3 i pointess since a reference takes up 3 bytes
-				// Length is the last nibble (last 4 bits) of the 2 reference bytes
-				int length = (reference & 0x000F) + 3;
-
-				// Offset if is all 8 bits in the first reference byte and the first nibble (4 bits) in the second reference byte
-				// The nibble from the second reference byte comes before the first reference byte
-				// EX: reference bytes = 0x12 0x34
-				//     offset = 0x312
-				int offset = ((reference & 0xFF00) >> 8) | ((reference & 0x00F0) << 4);
-
-				// Convert the offset to how many bytes away from the end of the buffer to start reading from
-				int backSet = (memPosition - 18 - offset) & 0xFFF;
-
-				// Calculate the actual location in the file
-				int readLocation = memPosition - backSet;
-
-				// Handle case where the offset is past the beginning of the file
-				if (readLocation < 0) {
-					// Determine how many zeros to write
-					int amt = -readLocation;
-					if (length <= amt) {
-						amt = length;
-					}
-					// Write the zeros
-					memset(&memBlock[memPosition], 0, sizeof(char) * amt);
-					// Ajuest positions and number of bytes left to copy
-					length -= amt;
-					readLocation += amt;
-					memPosition += amt;
-				}
+				printf(" %10u", jobs[i].strategySizes[strategy]);
+			}
+		}
+		printf(" %s\n", jobs[i].filename);
+	}
 
-				// Copy the rest of the reference bytes
-				while (length-- > 0) {
-					memBlock[memPosition++] = memBlock[readLocation++];
-				}
+	// Uncompressed size, compressed size, ratio and name of every estimated file, then the totals
+	uint64_t totalSize = 0;
+	uint64_t totalEstimate = 0;
+	for (int i = 0; i < jobCount; i++) {
+		if (jobs[i].type != JOB_ESTIMATE) {
+			continue;
+		}
+		if (jobs[i].failed) {
+			printf("FAILED     %10s %6s %s\n", "", "", jobs[i].filename);
+			continue;
+		}
+		double ratio = jobs[i].inputSize == 0 ? 0 : 100.0 * jobs[i].estimatedSize / jobs[i].inputSize;
+		if (jobs[i].skipped) {
+			printf("%10u %10s %6s %s\n", jobs[i].inputSize, "skipped", "", jobs[i].filename);
+		}
+		else {
+			printf("%10u %10lld %5.1f%% %s\n", jobs[i].inputSize, (long long)jobs[i].estimatedSize, ratio, jobs[i].filename);
+		}
+		totalSize += jobs[i].inputSize;
+		totalEstimate += (uint64_t)jobs[i].estimatedSize;
+	}
+	if (estimate && totalSize > 0) {
+		printf("%10llu %10llu %5.1f%% (total)\n", (unsigned long long)totalSize, (unsigned long long)totalEstimate, 100.0 * totalEstimate / totalSize);
+	}
+
+	free(jobs);
+	for (int i = 0; i < loadedBufferCount; i++) {
+		free(loadedBuffers[i]);
+	}
+	free(loadedBuffers);
+	return failures == 0 ? 0 : 1;
+}
 
+void addJob(Job* jobs, int* jobCount, char* filename, int type) {
+	Job* job = &jobs[(*jobCount)++];
+	snprintf(job->filename, sizeof(job->filename), "%s", filename);
+	job->type = type;
+	setJobOptions(job);
+}
 
-			}
-			// Go to the next reference bit in the block
-			block = (uint8_t) (block >> 1);
-		}
+/*
+* Copies the options given so far into the job (options only apply to the files after them)
+*/
+void setJobOptions(Job* job) {
+	job->format = headerFormat;
+	job->verify = verify;
+	job->optimal = optimal;
+	job->best = best;
+	job->probeRatio = probeRatio;
+	job->probeSkip = probeSkip;
+	job->estimateFast = estimateFast;
+	job->writeIndex = writeIndex;
+	job->baseData = baseData;
+	job->baseSize = baseSize;
+	job->baseCompressed = baseCompressed;
+	job->baseCompressedSize = baseCompressedSize;
+	job->window = dictionaryWindow;
+	job->dictionarySize = dictionaryWindowSize;
+}
 
+/*
+* Keeps a loaded buffer until the end, since jobs can still point into it
+*/
+void keepBuffer(void* buffer) {
+	if (buffer != NULL) {
+		loadedBuffers[loadedBufferCount++] = buffer;
+	}
+}
 
+int loadDictionary(char* filename) {
+	FILE* dictionary = fopen(filename, "rb");
+	if (dictionary == NULL) {
+		printf("ERROR: File not found: %s\n", filename);
+		return -1;
 	}
 
-	// Open the output file and copy the data into it
-	FILE* outfile = fopen(outfileName, "wb");
-	fwrite(memBlock, sizeof(char), (size_t)dataSize, outfile);
+	// Only the last window of it fits
+	fseek(dictionary, 0, SEEK_END);
+	long size = ftell(dictionary);
+	if (size > (long)Format::windowSize) {
+		fseek(dictionary, size - Format::windowSize, SEEK_SET);
+		size = Format::windowSize;
+	}
+	else {
+		fseek(dictionary, 0, SEEK_SET);
+	}
 
-	// Close files and free memory
-	free(memBlock);
-	fclose(outfile);
-	fclose(normal);
+	// Right align it in a new window so it is directly before the start of the file
+	uint8_t* window = (uint8_t*)calloc(Format::windowSize, sizeof(uint8_t));
+	if (window == NULL) {
+		puts("Unable to allocate memory");
+		fclose(dictionary);
+		return -1;
+	}
+	keepBuffer(window);
+	uint32_t readSize = (uint32_t)fread(&window[Format::windowSize - size], sizeof(uint8_t), (size_t)size, dictionary);
+	fclose(dictionary);
 
-	printf("Finished Decompressing %s\n", filename);
-	return;
+	if (readSize != (uint32_t)size) {
+		printf("ERROR: Unable to read dictionary: %s\n", filename);
+		return -1;
+	}
+	dictionaryWindow = window;
+	dictionaryWindowSize = readSize;
+	return 0;
 }
 
 /*
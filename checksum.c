@@ -0,0 +1,45 @@
+#include "checksum.h"
+
+#include "FunctionsAndDefines.h"
+
+// crcTable[0] is the usual byte table, crcTable[k] is a byte followed by k zero bytes
+// so 8 bytes can be done at once with independent lookups
+static uint32_t crcTable[8][256];
+
+static int initializeCrcTable() {
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+		}
+		crcTable[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int k = 1; k < 8; k++) {
+			crcTable[k][i] = (crcTable[k - 1][i] >> 8) ^ crcTable[0][crcTable[k - 1][i] & 0xFF];
+		}
+	}
+	return 1;
+}
+
+// Filled in before main, so threads never race on it
+static const int crcTableReady = initializeCrcTable();
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t size) {
+	crc = ~crc;
+
+	// 8 bytes at a time
+	while (size >= 8) {
+		uint32_t first = readLittleIntData(data, 0) ^ crc;
+		uint32_t second = readLittleIntData(data, 4);
+		crc = crcTable[7][first & 0xFF] ^ crcTable[6][(first >> 8) & 0xFF] ^ crcTable[5][(first >> 16) & 0xFF] ^ crcTable[4][first >> 24] ^
+			crcTable[3][second & 0xFF] ^ crcTable[2][(second >> 8) & 0xFF] ^ crcTable[1][(second >> 16) & 0xFF] ^ crcTable[0][second >> 24];
+		data += 8;
+		size -= 8;
+	}
+
+	while (size-- > 0) {
+		crc = (crc >> 8) ^ crcTable[0][(crc ^ *data++) & 0xFF];
+	}
+	return ~crc;
+}
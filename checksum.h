@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (the zlib/PNG one), crc is 0 to start or the result of the previous part
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t size);
@@ -0,0 +1,733 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "jobs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "FunctionsAndDefines.h"
+#include "checksum.h"
+#include "lzssformat.h"
+#include "probe.h"
+
+// Progress bar over every job being run
+static int showProgress = 0;
+static Job *progressJobs = NULL;
+static int progressCount = 0;
+static int lastProgressPercent = -1;
+static int lastProgressFinished = -1;
+
+void showJobProgress(int show) {
+	showProgress = show;
+}
+
+/*
+* Redraws the progress bar if it changed (only called inside the jobProgress critical section)
+*/
+static void drawProgress() {
+	// Server requests report progress too, but there is no batch to draw a bar for
+	if (progressCount == 0) {
+		return;
+	}
+	double done = 0;
+	int finished = 0;
+	for (int i = 0; i < progressCount; i++) {
+		done += progressJobs[i].progress;
+		if (progressJobs[i].progress >= 1) {
+			++finished;
+		}
+	}
+	int percent = (int)(100 * done / progressCount);
+	if (percent == lastProgressPercent && finished == lastProgressFinished) {
+		return;
+	}
+	lastProgressPercent = percent;
+	lastProgressFinished = finished;
+
+	char bar[41];
+	for (int i = 0; i < 40; i++) {
+		bar[i] = i < percent * 40 / 100 ? '#' : '.';
+	}
+	bar[40] = '\0';
+	fprintf(stderr, "\r[%s] %3d%% (%d/%d files)", bar, percent, finished, progressCount);
+	fflush(stderr);
+}
+
+static void setJobProgress(Job *job, double progress) {
+	if (!showProgress) {
+		return;
+	}
+#pragma omp critical(jobProgress)
+	{
+		job->progress = progress;
+		drawProgress();
+	}
+}
+
+static int reportJobProgress(uint32_t bytesIn, uint32_t bytesOut, uint32_t totalIn, void *userData) {
+	// The bar only follows the input
+	(void)bytesOut;
+	setJobProgress((Job *)userData, totalIn == 0 ? 1.0 : (double)bytesIn / totalIn);
+	return 0;
+}
+
+static void startJobProgress(Job *jobs, int count) {
+	if (!showProgress || count <= 0) {
+		return;
+	}
+	progressJobs = jobs;
+	progressCount = count;
+	lastProgressPercent = -1;
+	lastProgressFinished = -1;
+	for (int i = 0; i < count; i++) {
+		jobs[i].progress = 0;
+	}
+}
+
+static void finishJobProgress() {
+	if (showProgress && progressCount > 0) {
+		fprintf(stderr, "\n");
+	}
+	progressJobs = NULL;
+	progressCount = 0;
+}
+
+/*
+* Makes the output file name by adding the extension to the input file name
+*/
+static void makeOutputName(const char *filename, const char *extension, char *outfileName) {
+	snprintf(outfileName, 512, "%.503s%s", filename, extension);
+}
+
+uint8_t *loadFile(const char *filename, uint32_t *size) {
+	// Try to open it
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		printf("ERROR: File not found: %s\n", filename);
+		return NULL;
+	}
+
+	// Read the whole file at once
+	fseek(file, 0, SEEK_END);
+	uint32_t fileSize = (uint32_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t *data = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)fileSize + 1));
+	if (data == NULL) {
+		puts("Unable to allocate memory");
+		fclose(file);
+		return NULL;
+	}
+	*size = (uint32_t)fread(data, sizeof(uint8_t), fileSize, file);
+	fclose(file);
+	return data;
+}
+
+int readJob(Job *job) {
+	if (job->failed) {
+		return -1;
+	}
+
+	job->input = loadFile(job->filename, &job->inputSize);
+	if (job->input == NULL) {
+		job->failed = 1;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+* Decodes the input into output, whatever the header is
+*/
+static int decodeInput(Job *job, LzHeader *header) {
+	if (readHeader(job->input, job->inputSize, job->format, header) != 0) {
+		printf("ERROR: Header doesn't match the file size: %s\n", job->filename);
+		return -1;
+	}
+	// Decoding skips padding after the data, but a check reports it
+	if (job->type == JOB_CHECK && header->paddingSize != 0) {
+		printf("ERROR: %u bytes after the compressed data: %s\n", header->paddingSize, job->filename);
+		return -1;
+	}
+
+	job->outputSize = header->uncompressedSize;
+	job->output = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)job->outputSize + 1));
+	if (job->output == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+	if (decompressData(&job->input[header->headerSize], header->dataSize, job->output, job->outputSize, job->window, NULL) != (int64_t)job->outputSize) {
+		printf("ERROR: Compressed data doesn't match the uncompressed size: %s\n", job->filename);
+		return -1;
+	}
+	return 0;
+}
+
+static const char *strategyNames[STRATEGY_COUNT] = { "greedy", "lazy", "optimal" };
+
+const char *strategyName(int strategy) {
+	return strategy >= 0 && strategy < STRATEGY_COUNT ? strategyNames[strategy] : "unknown";
+}
+
+/*
+* Compresses the data with every strategy at once and keeps the smallest output in job->compressed
+* The compressor state is per thread, so each one only needs its own buffers
+*/
+static int compressBest(Job *job, const uint8_t *data, uint32_t size, const uint8_t *dictionary) {
+	CompressedData results[STRATEGY_COUNT];
+	int failed[STRATEGY_COUNT];
+	memset(results, 0, sizeof(results));
+
+	// Every encoder reads the same padded input, the winner keeps it as its window
+	uint8_t *padded = padData(data, size, dictionary, job->dictionarySize);
+	if (padded == NULL) {
+		return -1;
+	}
+
+#pragma omp parallel for num_threads(STRATEGY_COUNT)
+	for (int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+		// Optimal is the slowest, so it drives the progress bar
+		setProgressCallback(strategy == STRATEGY_OPTIMAL ? reportJobProgress : NULL, job);
+		failed[strategy] = compressPaddedData(padded, size, job->dictionarySize, strategy, &results[strategy]);
+	}
+
+	// A strategy that ran out of memory just drops out
+	job->winner = -1;
+	for (int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+		job->strategySizes[strategy] = failed[strategy] ? 0 : results[strategy].compressedSize;
+		if (!failed[strategy] && (job->winner < 0 || results[strategy].compressedSize < results[job->winner].compressedSize)) {
+			job->winner = strategy;
+		}
+	}
+	for (int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+		if (strategy != job->winner) {
+			freeCompressedData(&results[strategy]);
+		}
+	}
+	if (job->winner < 0) {
+		free(padded);
+		return -1;
+	}
+	job->compressed = results[job->winner];
+	job->compressed.window = padded;
+	return 0;
+}
+
+static int processCompress(Job *job) {
+	printf("Compressing %s\n", job->filename);
+	const uint8_t *dictionary = &job->window[Format::windowSize - job->dictionarySize];
+	// Incompressible files aren't worth searching for matches
+	int incompressible = 0;
+	if (job->probeRatio > 0) {
+		ProbeResult probe = probeCompressibility(job->input, job->inputSize);
+		incompressible = !isCompressible(&probe, job->probeRatio);
+		if (incompressible && job->probeSkip) {
+			printf("Skipping %s (estimated %.0f%% of its size)\n", job->filename, probe.ratio * 100);
+			job->skipped = 1;
+			return 0;
+		}
+		else if (incompressible) {
+			printf("Storing %s (estimated %.0f%% of its size)\n", job->filename, probe.ratio * 100);
+		}
+	}
+
+	setProgressCallback(reportJobProgress, job);
+	int result;
+	if (incompressible) {
+		result = compressDataStored(job->input, job->inputSize, dictionary, job->dictionarySize, &job->compressed);
+	}
+	else if (job->best) {
+		result = compressBest(job, job->input, job->inputSize, dictionary);
+	}
+	else if (job->optimal) {
+		result = compressDataOptimal(job->input, job->inputSize, dictionary, job->dictionarySize, &job->compressed);
+	}
+	else if (job->baseCompressed != NULL) {
+		result = recompressData(job->input, job->inputSize, job->baseData, job->baseSize, job->baseCompressed, job->baseCompressedSize, dictionary, job->dictionarySize, &job->compressed);
+	}
+	else {
+		result = compressData(job->input, job->inputSize, dictionary, job->dictionarySize, &job->compressed);
+	}
+	if (result != 0) {
+		return -1;
+	}
+
+	if (job->writeIndex) {
+		CompressedData *compressed = &job->compressed;
+		if (buildSeekIndex(&compressed->compressed[8], compressed->compressedSize - 8, &compressed->window[Format::windowSize], compressed->size, compressed->window, SEEK_INDEX_INTERVAL, &job->seekIndex) != 0) {
+			printf("ERROR: Unable to build the seek index: %s\n", job->filename);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int processDecompress(Job *job) {
+	printf("Decompressing %s\n", job->filename);
+	LzHeader header;
+	if (decodeInput(job, &header) != 0) {
+		return -1;
+	}
+
+	if (job->writeIndex) {
+		if (buildSeekIndex(&job->input[header.headerSize], header.dataSize, job->output, job->outputSize, job->window, SEEK_INDEX_INTERVAL, &job->seekIndex) != 0) {
+			printf("ERROR: Unable to build the seek index: %s\n", job->filename);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int processTranscode(Job *job) {
+	printf("Transcoding %s\n", job->filename);
+	LzHeader header;
+	if (decodeInput(job, &header) != 0) {
+		return -1;
+	}
+
+	// Compress the decoded data straight away, the compressor keeps its own copy
+	const uint8_t *dictionary = &job->window[Format::windowSize - job->dictionarySize];
+	setProgressCallback(reportJobProgress, job);
+	int result;
+	if (job->best) {
+		result = compressBest(job, job->output, job->outputSize, dictionary);
+	}
+	else if (job->optimal) {
+		result = compressDataOptimal(job->output, job->outputSize, dictionary, job->dictionarySize, &job->compressed);
+	}
+	else {
+		result = compressData(job->output, job->outputSize, dictionary, job->dictionarySize, &job->compressed);
+	}
+	free(job->output);
+	job->output = NULL;
+	if (result != 0) {
+		return -1;
+	}
+
+	// The file keeps its header format, so only the header size differs
+	job->sourceFormat = header.format;
+	uint32_t transcodedSize = job->compressed.compressedSize - 8 + header.headerSize;
+	job->unchanged = transcodedSize >= job->inputSize;
+	return 0;
+}
+
+static int processEstimate(Job *job) {
+	// Same choice of encoder as compressing
+	int level = job->optimal ? ESTIMATE_OPTIMAL : ESTIMATE_GREEDY;
+	if (job->estimateFast) {
+		level = ESTIMATE_FAST;
+	}
+	else if (job->probeRatio > 0) {
+		ProbeResult probe = probeCompressibility(job->input, job->inputSize);
+		if (!isCompressible(&probe, job->probeRatio)) {
+			if (job->probeSkip) {
+				job->skipped = 1;
+				job->estimatedSize = 0;
+				return 0;
+			}
+			level = ESTIMATE_STORED;
+		}
+	}
+
+	const uint8_t *dictionary = &job->window[Format::windowSize - job->dictionarySize];
+	setProgressCallback(reportJobProgress, job);
+	job->estimatedSize = estimateCompressedSize(job->input, job->inputSize, dictionary, job->dictionarySize, level);
+	return job->estimatedSize < 0 ? -1 : 0;
+}
+
+static int processCheck(Job *job) {
+	// Decoding checks the header sizes, so all that is left is the checksum
+	LzHeader header;
+	if (decodeInput(job, &header) != 0) {
+		return -1;
+	}
+	job->checksum = crc32Update(0, job->output, job->outputSize);
+	free(job->output);
+	job->output = NULL;
+	return 0;
+}
+
+int processJob(Job *job) {
+	if (job->failed) {
+		return -1;
+	}
+
+	int result;
+	if (job->type == JOB_COMPRESS) {
+		result = processCompress(job);
+	}
+	else if (job->type == JOB_DECOMPRESS) {
+		result = processDecompress(job);
+	}
+	else if (job->type == JOB_CHECK) {
+		result = processCheck(job);
+	}
+	else if (job->type == JOB_ESTIMATE) {
+		result = processEstimate(job);
+	}
+	else {
+		result = processTranscode(job);
+	}
+	if (result != 0) {
+		job->failed = 1;
+	}
+
+	free(job->input);
+	job->input = NULL;
+	return job->failed ? -1 : 0;
+}
+
+/*
+* Writes the data to the file (through a temporary file if it replaces the input)
+*/
+static int writeOutput(Job *job, const char *outfileName, const uint8_t *data, uint32_t size) {
+	char tempName[512];
+	const char *writeName = outfileName;
+	if (strcmp(outfileName, job->filename) == 0) {
+		makeOutputName(job->filename, ".tmp", tempName);
+		writeName = tempName;
+	}
+
+	// Open the output file and copy the data into it
+	FILE *outfile = fopen(writeName, "wb");
+	if (outfile == NULL) {
+		printf("ERROR: Unable to open output file: %s\n", writeName);
+		return -1;
+	}
+	size_t written = fwrite(data, sizeof(uint8_t), size, outfile);
+	fclose(outfile);
+	if (written != size) {
+		printf("ERROR: Unable to write output file: %s\n", writeName);
+		remove(writeName);
+		return -1;
+	}
+
+	if (writeName != outfileName) {
+		remove(outfileName);
+		if (rename(writeName, outfileName) != 0) {
+			printf("ERROR: Unable to replace %s\n", outfileName);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int writeJob(Job *job) {
+	if (job->failed) {
+		free(job->output);
+		freeCompressedData(&job->compressed);
+		freeSeekIndex(&job->seekIndex);
+		job->output = NULL;
+		setJobProgress(job, 1);
+		return -1;
+	}
+
+	// Check the compressed data before it goes anywhere
+	if ((job->type == JOB_COMPRESS || job->type == JOB_TRANSCODE) && job->verify && !job->skipped) {
+		int64_t difference = verifyCompressedData(&job->compressed);
+		if (difference == -1) {
+			printf("Verified %s\n", job->filename);
+		}
+		else if (difference == VERIFY_OUT_OF_MEMORY) {
+			printf("ERROR: Not enough memory to verify %s\n", job->filename);
+			job->failed = 1;
+		}
+		else {
+			printf("ERROR: Verification failed for %s: output differs at offset %lld\n", job->filename, (long long)difference);
+			job->failed = 1;
+		}
+	}
+
+	// The index sits next to the compressed file
+	if (!job->failed && job->writeIndex && !job->skipped && (job->type == JOB_COMPRESS || job->type == JOB_DECOMPRESS)) {
+		char indexName[512];
+		if (job->type == JOB_COMPRESS) {
+			makeOutputName(job->filename, ".lz.idx", indexName);
+		}
+		else {
+			makeOutputName(job->filename, ".idx", indexName);
+		}
+		if (saveSeekIndex(&job->seekIndex, indexName) != 0) {
+			job->failed = 1;
+		}
+	}
+	freeSeekIndex(&job->seekIndex);
+
+	if (!job->failed) {
+		char outfileName[512];
+		if (job->skipped && job->type == JOB_COMPRESS) {
+			printf("Skipped %s\n", job->filename);
+		}
+		else if (job->type == JOB_COMPRESS) {
+			makeOutputName(job->filename, ".lz", outfileName);
+			if (writeOutput(job, outfileName, job->compressed.compressed, job->compressed.compressedSize) != 0) {
+				job->failed = 1;
+			}
+			else {
+				printf("Finished Compressing %s\n", job->filename);
+			}
+		}
+		else if (job->type == JOB_DECOMPRESS) {
+			makeOutputName(job->filename, ".raw", outfileName);
+			if (writeOutput(job, outfileName, job->output, job->outputSize) != 0) {
+				job->failed = 1;
+			}
+			else {
+				printf("Finished Decompressing %s\n", job->filename);
+			}
+		}
+		else if (job->type == JOB_CHECK || job->type == JOB_ESTIMATE) {
+			// Nothing to write, the checksum or size goes in the manifest
+		}
+		else if (job->unchanged) {
+			printf("Kept %s (transcoding didn't make it smaller)\n", job->filename);
+		}
+		else {
+			// Replace the file, keeping its header format
+			uint8_t *data = job->compressed.compressed;
+			uint32_t size = job->compressed.compressedSize;
+			if (job->sourceFormat == LZ_FORMAT_FF7) {
+				writeLittleIntData(data, 4, size - 8);
+				data += 4;
+				size -= 4;
+			}
+			if (writeOutput(job, job->filename, data, size) != 0) {
+				job->failed = 1;
+			}
+			else {
+				printf("Finished Transcoding %s (%u -> %u bytes)\n", job->filename, job->inputSize, size);
+			}
+		}
+	}
+
+	free(job->output);
+	job->output = NULL;
+	freeCompressedData(&job->compressed);
+	setJobProgress(job, 1);
+	return job->failed ? -1 : 0;
+}
+
+int runJobs(Job *jobs, int count) {
+	if (count <= 0) {
+		return 0;
+	}
+
+	startJobProgress(jobs, count);
+
+	// At most three jobs are in memory at once
+	// Step i reads job i + 1, processes job i, and writes job i - 1
+	readJob(&jobs[0]);
+	for (int i = 0; i <= count; i++) {
+#pragma omp parallel sections num_threads(3)
+		{
+#pragma omp section
+			{
+				if (i + 1 < count) {
+					readJob(&jobs[i + 1]);
+				}
+			}
+#pragma omp section
+			{
+				if (i < count) {
+					processJob(&jobs[i]);
+				}
+			}
+#pragma omp section
+			{
+				if (i > 0) {
+					writeJob(&jobs[i - 1]);
+				}
+			}
+		}
+	}
+
+	finishJobProgress();
+
+	int failures = 0;
+	for (int i = 0; i < count; i++) {
+		if (jobs[i].failed) {
+			++failures;
+		}
+	}
+	return failures;
+}
+
+int runJobsParallel(Job *jobs, int count) {
+	startJobProgress(jobs, count);
+
+	// Each thread runs whole jobs, so there are as many files in memory as threads
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < count; i++) {
+		readJob(&jobs[i]);
+		processJob(&jobs[i]);
+		writeJob(&jobs[i]);
+	}
+
+	finishJobProgress();
+
+	int failures = 0;
+	for (int i = 0; i < count; i++) {
+		if (jobs[i].failed) {
+			++failures;
+		}
+	}
+	return failures;
+}
+/*
+* Estimates the uncompressed size of a compressed file from its first 8 bytes
+*/
+static uint64_t estimateUncompressedSize(const Job *job, const uint8_t *start, uint32_t fileSize) {
+	uint32_t firstInt = readLittleIntData(start, 0);
+	// Same choice as readHeader: an exact FF7 size wins over an SMB header followed by padding
+	int smbHeader = fileSize >= 8 && firstInt >= 8 && firstInt <= fileSize;
+	if (smbHeader && (job->format == LZ_FORMAT_SMB || (job->format == LZ_FORMAT_AUTO && firstInt + 4ull != fileSize))) {
+		return readLittleIntData(start, 4);
+	}
+
+	// FF7 files don't store it, so assume the most the stream can decode to
+	return Format::maxDecodedSize(fileSize);
+}
+
+uint64_t estimateJobMemory(const Job *job) {
+	FILE *file = fopen(job->filename, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+	uint8_t start[8] = { 0 };
+	fseek(file, 0, SEEK_END);
+	uint32_t fileSize = (uint32_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+	fread(start, sizeof(uint8_t), sizeof(start), file);
+	fclose(file);
+
+	// The compressor has the input with the window in front and an output 1/4 bigger than it
+	uint64_t rawSize = job->type == JOB_COMPRESS || job->type == JOB_ESTIMATE ? fileSize : estimateUncompressedSize(job, start, fileSize);
+	uint64_t compressSize = rawSize + Format::windowSize + Format::maxLength + rawSize + rawSize / 4 + 16;
+	// Plus the suffix array, ranks, matches and costs
+	if (job->optimal || job->best) {
+		compressSize += (rawSize + Format::windowSize) * 8 + rawSize * 14;
+	}
+	// Racing runs the greedy and lazy compressors next to it, reading the same input
+	if (job->best) {
+		compressSize += 2 * (rawSize + rawSize / 4 + 16);
+	}
+
+	// Each checkpoint holds a window
+	uint64_t indexSize = job->writeIndex ? (rawSize / SEEK_INDEX_INTERVAL + 1) * sizeof(SeekCheckpoint) : 0;
+
+	if (job->type == JOB_COMPRESS) {
+		// The file, the compressor buffers, and the data decoded by verifying
+		return fileSize + compressSize + (job->verify ? rawSize : 0) + indexSize;
+	}
+	else if (job->type == JOB_DECOMPRESS) {
+		return fileSize + rawSize + indexSize;
+	}
+	else if (job->type == JOB_CHECK) {
+		return fileSize + rawSize;
+	}
+	else if (job->type == JOB_ESTIMATE) {
+		// Only the input buffers of the compressor (and the fast estimate doesn't even need those)
+		return fileSize + (job->estimateFast ? 0 : compressSize - rawSize - rawSize / 4 - 16);
+	}
+	// The input is freed while compressing, but the decoded data is still there
+	return fileSize + rawSize + compressSize + (job->verify ? rawSize : 0);
+}
+
+typedef struct {
+	uint64_t estimate;
+	int job;
+	int started;
+}BudgetEntry;
+
+/*
+* Sorts the largest estimates first (keeping the order of equal ones)
+*/
+static int compareBudgetEntries(const void *a, const void *b) {
+	const BudgetEntry *entryA = (const BudgetEntry *)a;
+	const BudgetEntry *entryB = (const BudgetEntry *)b;
+	if (entryA->estimate != entryB->estimate) {
+		return entryA->estimate < entryB->estimate ? 1 : -1;
+	}
+	return entryA->job - entryB->job;
+}
+
+int runJobsWithBudget(Job *jobs, int count, uint64_t maxMemory) {
+	BudgetEntry *entries = (BudgetEntry *)malloc(sizeof(BudgetEntry) * (count + 1));
+	if (entries == NULL) {
+		puts("Unable to allocate memory");
+		return count;
+	}
+	for (int i = 0; i < count; i++) {
+		entries[i].estimate = estimateJobMemory(&jobs[i]);
+		entries[i].job = i;
+		entries[i].started = 0;
+	}
+	// Largest first, so the big jobs don't end up alone at the end
+	qsort(entries, count, sizeof(BudgetEntry), compareBudgetEntries);
+	startJobProgress(jobs, count);
+
+	int startedCount = 0;
+	int running = 0;
+	uint64_t used = 0;
+
+#pragma omp parallel
+	{
+		while (1) {
+			// Take the largest job that fits in what is left
+			BudgetEntry *next = NULL;
+			int finished = 0;
+#pragma omp critical(jobBudget)
+			{
+				if (startedCount == count) {
+					finished = 1;
+				}
+				else {
+					for (int i = 0; i < count && next == NULL; i++) {
+						if (!entries[i].started && (used + entries[i].estimate <= maxMemory || running == 0)) {
+							next = &entries[i];
+						}
+					}
+					if (next != NULL) {
+						next->started = 1;
+						++startedCount;
+						++running;
+						used += next->estimate;
+					}
+				}
+			}
+			if (finished) {
+				break;
+			}
+			// Nothing fits until a running job finishes
+			if (next == NULL) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			readJob(&jobs[next->job]);
+			processJob(&jobs[next->job]);
+			writeJob(&jobs[next->job]);
+
+#pragma omp critical(jobBudget)
+			{
+				--running;
+				used -= next->estimate;
+			}
+		}
+	}
+	free(entries);
+
+	finishJobProgress();
+
+	int failures = 0;
+	for (int i = 0; i < count; i++) {
+		if (jobs[i].failed) {
+			++failures;
+		}
+	}
+	return failures;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+
+#include "lzss.h"
+#include "seekindex.h"
+
+#define JOB_COMPRESS 0
+#define JOB_DECOMPRESS 1
+#define JOB_TRANSCODE 2
+#define JOB_CHECK 3
+#define JOB_ESTIMATE 4
+
+typedef struct {
+	// Filled in by the caller
+	char filename[512];
+	int type;                   // JOB_COMPRESS, JOB_DECOMPRESS, JOB_TRANSCODE (decompress and compress again in place) JOB_CHECK (decompress without writing) or JOB_ESTIMATE (compressed size without writing)
+	int format;                 // Header format when decompressing/transcoding (LZ_FORMAT_*)
+	int verify;                 // Decode the compressed output in memory and compare it against the input
+	int optimal;                // Compress with compressDataOptimal (ignores the base)
+	int best;                   // Compress with every strategy at once and keep the smallest (ignores the base and optimal)
+	double probeRatio;          // Files probed to compress worse than this are stored as literals (0 to compress everything)
+	int probeSkip;              // Skip those files instead of storing them
+	int estimateFast;           // Estimate with greedy hash matches instead of the exact size (ESTIMATE_FAST)
+	const uint8_t *window;      // Format::windowSize byte window (zeros, or zeros followed by a dictionary)
+	uint32_t dictionarySize;    // How much of the end of the window is dictionary
+	int writeIndex;             // Write a seek index next to the compressed file
+	const uint8_t *baseData;    // Previous version of the file to compress (or NULL)
+	uint32_t baseSize;
+	const uint8_t *baseCompressed;  // Previous version compressed (with the same dictionary)
+	uint32_t baseCompressedSize;
+
+	// Filled in while the job runs
+	int failed;
+	uint8_t *input;             // Contents of the input file
+	uint32_t inputSize;
+	uint8_t *output;            // Decompressed data
+	uint32_t outputSize;
+	CompressedData compressed;  // Compressed data (and the input for verifying)
+	SeekIndex seekIndex;
+	int sourceFormat;           // Header format of the file being transcoded
+	int unchanged;              // Transcoding didn't make the file smaller, so it is left alone
+	uint32_t checksum;          // CRC-32 of the decompressed data (checking)
+	int skipped;                // The probe found the file incompressible, so nothing is written
+	int64_t estimatedSize;      // Size the file compresses to, header included (estimating, 0 if it would be skipped)
+	double progress;            // How much of the job is done (0 to 1), for the progress bar
+	int winner;                 // Strategy that gave the smallest output (best)
+	uint32_t strategySizes[STRATEGY_COUNT];  // Compressed size from every strategy (0 if it failed)
+}Job;
+
+// Name of a STRATEGY_* for reports
+const char *strategyName(int strategy);
+
+// Reads a whole file into memory, returns NULL on failure
+uint8_t *loadFile(const char *filename, uint32_t *size);
+
+// The three stages of a job, each one does nothing if the job already failed
+// Returns 0 on success, or -1 if the job failed
+int readJob(Job *job);
+
+int processJob(Job *job);
+
+int writeJob(Job *job);
+
+// Draws one progress bar on stderr for all the jobs being run
+void showJobProgress(int show);
+
+// Runs every job through the stages, reading the next job and writing the previous job while one is processed
+// Returns the number of jobs that failed
+int runJobs(Job *jobs, int count);
+
+// Runs whole jobs on every thread at once (the compressor state is per thread)
+// Returns the number of jobs that failed
+int runJobsParallel(Job *jobs, int count);
+
+// Roughly how much memory the job needs at once, from the file size (and the header of compressed files)
+uint64_t estimateJobMemory(const Job *job);
+
+// Like runJobsParallel, but a job only starts while the estimates of the running jobs fit in maxMemory bytes
+// The largest jobs go first, and smaller ones fill in what is left (a job that never fits runs alone)
+// Returns the number of jobs that failed
+int runJobsWithBudget(Job *jobs, int count, uint64_t maxMemory);
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <stdlib.h>
 
 #include "FunctionsAndDefines.h"
+#include "lzssformat.h"
+#include "probe.h"
+#include "suffixarray.h"
 
 #ifdef DEBUG
 #define VALIDATE_TREE checkTreeValidity()
@@ -34,36 +37,43 @@ typedef struct {
 	int value;
 }CompareResult;
 
+// Where an old stream of the same data (shifted by delta) can take over from the encoder
+typedef struct {
+	const uint8_t *input;     // Old LZSS stream (without the header)
+	uint32_t inputSize;
+	StreamPosition position;  // Next token of the old stream
+	uint32_t start;           // First index of the new data where old tokens are valid
+	uint32_t delta;           // New index - old index of the same data (wraps when negative)
+}Resync;
+
 static const TREETYPE rootConstant = 0xFFFF;
 static const TREETYPE nullConstant = 0xFFFD;
-static uint32_t filesize;
-static uint32_t compressedsize;
-static uint32_t inputIndex = 4096; // Offset for the 4096 "negative" values
-static uint32_t outputIndex = 0;
-static TREETYPE rootIndex;
-static TREETYPE binaryTreeIndex = 4095;
-static TreeNode binaryTree[4096];
-static uint8_t *inputData;
-static uint8_t *outputData;
-static int maxDepth = 0;
-
-/*
-* Initializes the Binary Search Tree to its initial state
-*/
-static void initializeBinaryTree() {
-	// Initialize the tree to all null values
-	for (TREETYPE i = 0; i < 4096; i++) {
-		binaryTree[i].parent = nullConstant;
-		binaryTree[i].leftChild = nullConstant;
-		binaryTree[i].rightChild = nullConstant;
-	}
-
-	// All values are initially negative
-	// The longest length is -18, so make
-	// the 18th from the end the initial root
-	binaryTree[4096 - 18].parent = rootConstant;
-	rootIndex = 4096 - 18;
-}
+static_assert(Format::windowSize <= nullConstant, "Every window position needs a tree node");
+static_assert(Format::maxLength % 2 == 0, "compareFast compares 2 bytes at a time");
+// Every thread gets its own compressor state, so files can be compressed in parallel
+static thread_local uint32_t filesize;
+static thread_local uint32_t compressedsize;
+static thread_local uint32_t inputIndex = Format::windowSize; // Offset for the window of "negative" values
+static thread_local uint32_t outputIndex = 0;
+static thread_local TREETYPE rootIndex;
+static thread_local TREETYPE binaryTreeIndex = Format::windowSize - 1;
+static thread_local TreeNode binaryTree[Format::windowSize];
+static thread_local uint8_t *inputData;
+static thread_local uint8_t *outputData;
+static thread_local int maxDepth = 0;
+// Control block being written
+static thread_local uint32_t posInBlock;
+static thread_local uint8_t curBlock;
+static thread_local uint32_t blockBackset;
+// Progress reporting
+// Only counts the size of the output instead of writing it (estimating)
+static thread_local int countOnly = 0;
+
+#define PROGRESS_INTERVAL 0x10000
+static thread_local ProgressCallback progressCallback = NULL;
+static thread_local void *progressUserData = NULL;
+static thread_local uint32_t nextProgress;
+static thread_local int cancelled;
 
 /*
 * Converts a tree index into a file index
@@ -75,7 +85,7 @@ static uint32_t convertToOffset(TREETYPE treePointer) {
 	}
 	if (treePointer > binaryTreeIndex) {
 		//         Base                Amount to start       Amount to wrap
-		return (inputIndex - 1) - (binaryTreeIndex) - (4096 - treePointer);
+		return (inputIndex - 1) - (binaryTreeIndex) - (Format::windowSize - treePointer);
 	}
 	else {
 		//           Base                          Amount behing
@@ -85,17 +95,17 @@ static uint32_t convertToOffset(TREETYPE treePointer) {
 
 /*
 * Compares two positions in the inputData for equality
-* If all 18 bytes are equal, then 0 is returned
+* If all Format::maxLength bytes are equal, then 0 is returned
 * Otherwise the difference between the first byte that's different is returned
 */
 static CompareResult compare(uint32_t index1, uint32_t index2) {
-	for (uint32_t i = 0; i < 18; i++) {
+	for (uint32_t i = 0; i < Format::maxLength; i++) {
 		int result = inputData[index1 + i] - inputData[index2 + i];
 		if (result != 0) {
 			return { i, result };
 		}
 	}
-	return { 18, 0 };
+	return { Format::maxLength, 0 };
 }
 
 /*
@@ -103,7 +113,7 @@ static CompareResult compare(uint32_t index1, uint32_t index2) {
 * This version does not give the number of similar bytes
 */
 static int compareFast(uint32_t index1, uint32_t index2) {
-	for (uint32_t i = 0; i < 18; i += 2) {
+	for (uint32_t i = 0; i < Format::maxLength; i += 2) {
 		uint16_t val1 = (inputData[index1 + i] << 8) | (inputData[index1 + i + 1]);
 		uint16_t val2 = (inputData[index2 + i] << 8) | (inputData[index2 + i + 1]);
 		int result = val1 - val2;
@@ -229,6 +239,32 @@ static void calculateNode(TREETYPE index) {
 	}
 }
 
+/*
+* Initializes the Binary Search Tree to its initial state
+*/
+static void initializeBinaryTree(uint32_t dictionarySize) {
+	// Initialize the tree to all null values
+	for (TREETYPE i = 0; i < Format::windowSize; i++) {
+		binaryTree[i].parent = nullConstant;
+		binaryTree[i].leftChild = nullConstant;
+		binaryTree[i].rightChild = nullConstant;
+	}
+
+	// All values are initially negative
+	// The longest length is -maxLength, so make
+	// the maxLength-th from the end the initial root
+	// With a dictionary, the last run of maxLength zeros is before it instead
+	TREETYPE firstIndex = (TREETYPE)(dictionarySize < Format::windowSize - Format::maxLength ? Format::windowSize - Format::maxLength - dictionarySize : 0);
+	binaryTree[firstIndex].parent = rootConstant;
+	rootIndex = firstIndex;
+
+	// Every dictionary position that fits maxLength bytes before the input
+	// gets inserted so it can be referenced like already seen data
+	for (TREETYPE i = firstIndex + 1; i <= Format::windowSize - Format::maxLength; i++) {
+		calculateNode(i);
+	}
+}
+
 /*
 * Takes a node index and removed it from the binary search tree
 * Its parent/children will become the nullConstant
@@ -358,13 +394,13 @@ static void removeNode(TREETYPE index) {
 
 /*
 * Fixes a tree after the sliding door is removed
-* This is done to remove references older than 4k back
+* This is done to remove references older than the window
 */
 static void fixTree(uint32_t length) {
 
 	for (uint32_t i = 0; i < length; i++) {
 		TREETYPE toRemove = binaryTreeIndex + 1u;
-		if (toRemove == 4096) {
+		if (toRemove == Format::windowSize) {
 			toRemove = 0;
 		}
 
@@ -385,18 +421,50 @@ static void fixTree(uint32_t length) {
 }
 
 /*
-* Finds the longest reference in the Binary Tree available
-* The tree will be fixed afterwards using the fixTree(uint32_t) method
+* Initializes the Binary Search Tree as if the encoder had just reached the index (a padded index)
 */
-static ReferenceBlock findMaxReference() {
-	ReferenceBlock maxReference = { 2, 0 };
+static void resumeBinaryTree(uint32_t index, uint32_t dictionarySize) {
+	binaryTreeIndex = Format::windowSize - 1;
+
+	// Close to the start the window still has "negative" values, so replay from the start
+	if (index < Format::windowSize + Format::windowSize) {
+		inputIndex = Format::windowSize;
+		initializeBinaryTree(dictionarySize);
+		fixTree(index - Format::windowSize);
+		inputIndex = index;
+		return;
+	}
+
+	// Otherwise the tree is just the last window of positions
+	inputIndex = index;
+	for (TREETYPE i = 0; i < Format::windowSize; i++) {
+		binaryTree[i].parent = nullConstant;
+		binaryTree[i].leftChild = nullConstant;
+		binaryTree[i].rightChild = nullConstant;
+	}
+	binaryTree[0].parent = rootConstant;
+	rootIndex = 0;
+	for (TREETYPE i = 1; i < Format::windowSize; i++) {
+		calculateNode(i);
+	}
+}
+
+/*
+* Finds the longest reference in the Binary Tree available (the tree isn't changed)
+*/
+static ReferenceBlock searchReference() {
+	ReferenceBlock maxReference = { Format::minLength - 1, 0 };
 	TREETYPE treePointer = rootIndex;
 
 	VALIDATE_TREE;
 	while (treePointer != nullConstant) {
 		uint32_t fileOffset = convertToOffset(treePointer);
 		CompareResult result = compare(inputIndex, fileOffset);
-		if (result.length > maxReference.length && inputIndex - fileOffset != 4096) {
+		// Don't let the reference run past the end of the file
+		if (result.length > filesize + Format::windowSize - inputIndex) {
+			result.length = filesize + Format::windowSize - inputIndex;
+		}
+		if (result.length > maxReference.length && inputIndex - fileOffset != Format::windowSize) {
 			maxReference.length = result.length;
 			maxReference.offset = fileOffset;
 		}
@@ -411,8 +479,17 @@ static ReferenceBlock findMaxReference() {
 			treePointer = binaryTree[treePointer].leftChild;
 		}
 	}
+	return maxReference;
+}
+
+/*
+* Finds the longest reference in the Binary Tree available
+* The tree will be fixed afterwards using the fixTree(uint32_t) method
+*/
+static ReferenceBlock findMaxReference() {
+	ReferenceBlock maxReference = searchReference();
 	
-	if (maxReference.length > 2) {
+	if (maxReference.length >= Format::minLength) {
 		fixTree(maxReference.length);
 	}
 	else {
@@ -423,6 +500,18 @@ static ReferenceBlock findMaxReference() {
 }
 
 int compressFile(char *filename) {
+	return compressFileWithDictionary(filename, NULL, 0);
+}
+
+int compress(FILE *input, FILE *output) {
+	return compressWithDictionary(input, output, NULL, 0);
+}
+
+int compressFileWithDictionary(char *filename, const uint8_t *dictionary, uint32_t dictionarySize) {
+	return compressFileAndKeep(filename, dictionary, dictionarySize, NULL);
+}
+
+int compressFileAndKeep(char *filename, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
 	// Try to open it
 	FILE* rawfile = fopen(filename, "rb");
 	if (rawfile == NULL) {
@@ -449,114 +538,737 @@ int compressFile(char *filename) {
 		return -1;
 	}
 
-	int result = compress(rawfile, outfile);
+	int returnValue = compressAndKeep(rawfile, outfile, dictionary, dictionarySize, result);
 	fclose(rawfile);
 	fclose(outfile);
-	return result;
+	return returnValue;
 }
 
-int compress(FILE *input, FILE *output) {
+int compressWithDictionary(FILE *input, FILE *output, const uint8_t *dictionary, uint32_t dictionarySize) {
+	return compressAndKeep(input, output, dictionary, dictionarySize, NULL);
+}
 
-	fseek(input, 0, SEEK_END);
-	filesize = (uint32_t)ftell(input);
-	fseek(input, 0, SEEK_SET);
+/*
+* Moves to the next bit in the control block, writing the block out when it is full
+*/
+static void nextBlockBit() {
+	++posInBlock;
+	if (posInBlock == 8) {
+		if (!countOnly) {
+			outputData[outputIndex - blockBackset] = curBlock;
+		}
+		posInBlock = 0;
+		curBlock = 0;
+		// Make room for the next control block
+		++outputIndex;
+		blockBackset = 1;
+	}
+}
 
-	// Add 4096 for "negative" values
-	uint32_t paddedFilesize = filesize + 4096;
-	inputData = (uint8_t *)malloc(sizeof(uint8_t) * paddedFilesize); 
-	if (inputData == NULL) {
-		puts("Unable to allocate memory");
-		return -1;
+/*
+* Writes the byte at inputIndex as a literal (inputIndex isn't moved)
+*/
+static void writeLiteral() {
+	if (!countOnly) {
+		outputData[outputIndex] = inputData[inputIndex];
 	}
-	memset(inputData, 0, sizeof(uint8_t) * 4096);
 
-	// Worst case scenario is 1/8 bigger thn inputData
-	// Make is 1/4 bigger anyways to be safe
-	outputData = (uint8_t *)malloc((sizeof(uint8_t) * (filesize + (filesize)))); // TODO Change back to filesize >> 2
-	if (outputData == NULL) {
-		puts("Unable to allocate memory");
-		return -1;
+	curBlock = (uint8_t)(curBlock | Format::flagMask(posInBlock));
+	++blockBackset;
+	++outputIndex;
+	nextBlockBit();
+}
+
+/*
+* Writes a reference at inputIndex to the data backset bytes before it (inputIndex isn't moved)
+*/
+static void writeReference(uint32_t backset, uint32_t length) {
+	// The window padding is a multiple of the window size, so inputIndex works as the position
+	if (!countOnly) {
+		writeBigShortData(outputData, outputIndex, Format::packReference(inputIndex, backset, length));
 	}
+	outputIndex += 2;
 
-	fread(&inputData[4096], sizeof(uint8_t), filesize, input);
+	// References leave their flag bit clear
+	blockBackset += 2;
+	nextBlockBit();
+}
 
-	outputIndex += 8;
+void setProgressCallback(ProgressCallback callback, void *userData) {
+	progressCallback = callback;
+	progressUserData = userData;
+}
 
-	initializeBinaryTree();
+/*
+* Starts counting progress from inputIndex
+*/
+static void startProgress() {
+	cancelled = 0;
+	nextProgress = inputIndex;
+}
 
-	uint32_t posInBlock = 0;
-	uint8_t curBlock = 0;
-	uint32_t blockBackset = 1;
-	// Make room for initial control block
-	outputIndex++;
-	int lastPercentDone = -1;
+/*
+* Tells the callback how far the encoder is, returns nonzero if it asked to stop
+*/
+static int reportProgress() {
+	nextProgress = inputIndex + PROGRESS_INTERVAL;
+	if (progressCallback != NULL && progressCallback(inputIndex - Format::windowSize, outputIndex, filesize, progressUserData) != 0) {
+		cancelled = 1;
+	}
+	return cancelled;
+}
 
-	while (inputIndex < paddedFilesize) {
-		float percentDone = (100.0f * (inputIndex - 4096)) / filesize;
-		int intPercentDone = (int)percentDone;
-		if (intPercentDone % 10 == 0 && intPercentDone != lastPercentDone) {
-			printf("%d%% Completed\n", intPercentDone);
-			lastPercentDone = intPercentDone;
+/*
+* Runs the encoder from inputIndex until end (a padded index)
+* With a resync, it stops early once it lands on a token of the old stream that can be reused
+* It also stops if the progress callback cancels
+*/
+static void encodeUntil(uint32_t end, Resync *resync) {
+	while (inputIndex < end) {
+		if (inputIndex >= nextProgress && reportProgress() != 0) {
+			return;
+		}
+
+		if (resync != NULL && inputIndex - Format::windowSize >= resync->start) {
+			// Catch the old stream up to the same data
+			uint32_t oldIndex = inputIndex - Format::windowSize - resync->delta;
+			while (resync->position.outputOffset < oldIndex) {
+				uint32_t length;
+				uint32_t backSet;
+				if (readToken<Format>(resync->input, resync->inputSize, &resync->position, &length, &backSet) < 0) {
+					break;
+				}
+			}
+			if (resync->position.outputOffset == oldIndex) {
+				return;
+			}
 		}
 
 		ReferenceBlock maxReference = findMaxReference();
 		
 		// If the reference is long enough to use
-		if (maxReference.length >= 3) {
-			// Calculate the reference
-			uint32_t backset = inputIndex - maxReference.offset;
-
-			uint32_t offset = (inputIndex & 0xFFF) - 18 - backset;
-			uint8_t leftByte = (offset & 0xFF);
-			uint8_t rightByte = (((offset >> 8) & 0xF) << 4) | ((maxReference.length - 3) & 0xF);
-
-			// Write it out
-			outputData[outputIndex] = leftByte;
-			outputData[outputIndex + 1] = rightByte;
-			outputIndex += 2;
-
-			// Set control values and update data positions
+		if (maxReference.length >= Format::minLength) {
+			writeReference(inputIndex - maxReference.offset, maxReference.length);
 			inputIndex += maxReference.length;
-			curBlock = (uint8_t)(curBlock | (0x0 << (uint8_t)posInBlock));
-			blockBackset += 2;
-
 		}// The reference is too short (write raw value)
 		else {
-			outputData[outputIndex] = inputData[inputIndex];
+			writeLiteral();
+			++inputIndex;
+		}
+	}
+}
 
-			curBlock = (uint8_t)(curBlock | (0x1 << (uint8_t)posInBlock));
+/*
+* Runs the encoder from inputIndex until end (a padded index), but a reference is only written
+* if the one starting at the next byte isn't longer (otherwise a literal is written, and the next one is tried the same way)
+*/
+static void encodeLazyUntil(uint32_t end) {
+	ReferenceBlock current = searchReference();
+	while (inputIndex < end) {
+		if (inputIndex >= nextProgress && reportProgress() != 0) {
+			return;
+		}
+
+		if (current.length < Format::minLength) {
+			fixTree(1);
+			writeLiteral();
 			++inputIndex;
-			++blockBackset;
-			++outputIndex;
+			if (inputIndex < end) {
+				current = searchReference();
+			}
+			continue;
 		}
 
-		++posInBlock;
-		if (posInBlock == 8) {
-			outputData[outputIndex - blockBackset] = curBlock;
-			posInBlock = 0;
-			curBlock = 0;
-			// Make room for the next control block
-			++outputIndex;
-			blockBackset = 1;
+		// Look one byte ahead (nothing beats the longest reference)
+		fixTree(1);
+		ReferenceBlock next = { Format::minLength - 1, 0 };
+		if (current.length < Format::maxLength && inputIndex + 1 < end) {
+			++inputIndex;
+			next = searchReference();
+			--inputIndex;
+		}
+
+		if (next.length > current.length) {
+			writeLiteral();
+			++inputIndex;
+			current = next;
+		}
+		else {
+			writeReference(inputIndex - current.offset, current.length);
+			// The first byte is already in the tree
+			++inputIndex;
+			fixTree(current.length - 1);
+			inputIndex += current.length - 1;
+			if (inputIndex < end) {
+				current = searchReference();
+			}
 		}
 	}
+}
 
-	// Make sure you don't have any data bytes without a reference block
-	if (posInBlock != 0) {
-		outputData[outputIndex - blockBackset] = curBlock;
+/*
+* Writes the last control block and the header
+*/
+static void finishOutput() {
+	if (countOnly) {
+		return;
 	}
 
+	// Make sure you don't have any data bytes without a reference block
+	// (An empty one left at the end is written as 0)
+	outputData[outputIndex - blockBackset] = curBlock;
+
 	// Write compressed filesize
 	writeLittleIntData(outputData, 0, outputIndex);
 
 	// Write uncompressed filezise
 	writeLittleIntData(outputData, 4, filesize);
+}
+
+/*
+* Starts writing at the beginning of the input, after the header and the first control block
+*/
+static void startOutput() {
+	inputIndex = Format::windowSize;
+	outputIndex = 8;
+
+	posInBlock = 0;
+	curBlock = 0;
+	blockBackset = 1;
+	// Make room for initial control block
+	outputIndex++;
+
+	startProgress();
+}
+
+/*
+* Compresses the data in inputData into outputData (including the header)
+* Returns -1 if the progress callback cancelled it
+*/
+static int compressBuffers(uint32_t dictionarySize) {
+	if (dictionarySize > Format::windowSize) {
+		dictionarySize = Format::windowSize;
+	}
+
+	// Reset the state left over from any previous file
+	binaryTreeIndex = Format::windowSize - 1;
+	startOutput();
+
+	initializeBinaryTree(dictionarySize);
+
+	encodeUntil(filesize + Format::windowSize, NULL);
+	finishOutput();
+	return cancelled ? -1 : 0;
+}
+
+/*
+* Allocates the input with the window (and the dictionary) in front, without the data
+*/
+static uint8_t *allocateInput(uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize) {
+	// Only the last window of a dictionary fits
+	if (dictionarySize > Format::windowSize) {
+		dictionary += dictionarySize - Format::windowSize;
+		dictionarySize = Format::windowSize;
+	}
+
+	// Add the window size for "negative" values
+	// Add maxLength at the end so comparisons near the end stay in bounds
+	uint8_t *input = (uint8_t *)calloc((size_t)size + Format::windowSize + Format::maxLength, sizeof(uint8_t));
+	if (input == NULL) {
+		puts("Unable to allocate memory");
+		return NULL;
+	}
+	// The window starts as zeros followed by the dictionary (if any)
+	if (dictionarySize > 0) {
+		memcpy(&input[Format::windowSize - dictionarySize], dictionary, sizeof(uint8_t) * dictionarySize);
+	}
+	return input;
+}
+
+/*
+* Allocates the output buffer for a file of size filesize
+*/
+static int allocateOutput() {
+	// Nothing is written when only counting
+	if (countOnly) {
+		outputData = NULL;
+		return 0;
+	}
+
+	// Worst case scenario is 1/8 bigger thn inputData
+	// Make is 1/4 bigger anyways to be safe (plus the header and last control block)
+	outputData = (uint8_t *)malloc((sizeof(uint8_t) * (filesize + (filesize >> 2) + 16)));
+	if (outputData == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+* Allocates the input (with the window in front) and output buffers for a file of the given size
+*/
+static int allocateBuffers(uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize) {
+	filesize = size;
+	inputData = allocateInput(size, dictionary, dictionarySize);
+	if (inputData == NULL) {
+		return -1;
+	}
+	if (allocateOutput() != 0) {
+		free(inputData);
+		inputData = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+* Hands the buffers over to result, or frees them if result is NULL
+*/
+static void releaseBuffers(CompressedData *result) {
+	if (result != NULL) {
+		result->window = inputData;
+		result->size = filesize;
+		result->compressed = outputData;
+		result->compressedSize = outputIndex;
+	}
+	else {
+		free(inputData);
+		free(outputData);
+	}
+	inputData = NULL;
+	outputData = NULL;
+}
+
+int compressAndKeep(FILE *input, FILE *output, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
+	fseek(input, 0, SEEK_END);
+	uint32_t size = (uint32_t)ftell(input);
+	fseek(input, 0, SEEK_SET);
+
+	if (allocateBuffers(size, dictionary, dictionarySize) != 0) {
+		return -1;
+	}
+
+	fread(&inputData[Format::windowSize], sizeof(uint8_t), filesize, input);
+	if (compressBuffers(dictionarySize) != 0) {
+		releaseBuffers(NULL);
+		return -1;
+	}
 
 	// Write actual data
 	fwrite(outputData, sizeof(uint8_t), outputIndex, output);
 
-	// Cleanup
-	free(inputData);
-	free(outputData);
+	releaseBuffers(result);
+	return 0;
+}
+
+int compressData(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
+	if (allocateBuffers(size, dictionary, dictionarySize) != 0) {
+		return -1;
+	}
+
+	memcpy(&inputData[Format::windowSize], data, sizeof(uint8_t) * size);
+	if (compressBuffers(dictionarySize) != 0) {
+		releaseBuffers(NULL);
+		return -1;
+	}
+
+	releaseBuffers(result);
+	return 0;
+}
+
+/*
+* Same as compressBuffers, but with lazy matching
+*/
+static int compressBuffersLazy(uint32_t dictionarySize) {
+	if (dictionarySize > Format::windowSize) {
+		dictionarySize = Format::windowSize;
+	}
+	binaryTreeIndex = Format::windowSize - 1;
+	startOutput();
+	initializeBinaryTree(dictionarySize);
+
+	encodeLazyUntil(filesize + Format::windowSize);
+	finishOutput();
+	return cancelled ? -1 : 0;
+}
+
+int compressDataLazy(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
+	if (allocateBuffers(size, dictionary, dictionarySize) != 0) {
+		return -1;
+	}
+	memcpy(&inputData[Format::windowSize], data, sizeof(uint8_t) * size);
+
+	if (compressBuffersLazy(dictionarySize) != 0) {
+		releaseBuffers(NULL);
+		return -1;
+	}
+	releaseBuffers(result);
+	return 0;
+}
+
+/*
+* Same as compressBuffers, but picks the cheapest tokens from every match the suffix array finds
+* Returns -1 if out of memory or the progress callback cancelled it
+*/
+static int compressBuffersOptimal() {
+	uint32_t size = filesize;
+	uint8_t *lengths = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)size + 1));
+	uint32_t *distances = (uint32_t *)malloc(sizeof(uint32_t) * ((size_t)size + 1));
+	uint64_t *costs = (uint64_t *)malloc(sizeof(uint64_t) * ((size_t)size + 1));
+	uint8_t *choices = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)size + 1));
+	// The window counts as data before the file, so references into it are found too
+	// (a reference can't go back a whole window, that would be the byte being written)
+	if (lengths == NULL || distances == NULL || costs == NULL || choices == NULL ||
+		findLongestMatches(inputData, size + Format::windowSize, Format::windowSize, Format::windowSize - 1, Format::maxLength, lengths, distances) != 0) {
+		puts("Unable to allocate memory");
+		free(lengths);
+		free(distances);
+		free(costs);
+		free(choices);
+		return -1;
+	}
+
+	// Cheapest way to encode everything from each position on, in bits
+	// A literal is a flag and a byte, a reference is a flag and 2 bytes
+	// Any length up to the longest match is possible, since a shorter match is a prefix of it
+	costs[size] = 0;
+	for (uint32_t i = size; i-- > 0;) {
+		costs[i] = costs[i + 1] + 9;
+		choices[i] = 1;
+		for (uint32_t length = Format::minLength; length <= lengths[i]; length++) {
+			// Longer references win ties, fewer tokens can only save a control byte
+			if (costs[i + length] + 17 <= costs[i]) {
+				costs[i] = costs[i + length] + 17;
+				choices[i] = (uint8_t)length;
+			}
+		}
+	}
+
+	startOutput();
+	while (inputIndex < filesize + Format::windowSize) {
+		if (inputIndex >= nextProgress && reportProgress() != 0) {
+			break;
+		}
+		uint32_t i = inputIndex - Format::windowSize;
+		if (choices[i] >= Format::minLength) {
+			writeReference(distances[i], choices[i]);
+		}
+		else {
+			writeLiteral();
+		}
+		inputIndex += choices[i];
+	}
+	finishOutput();
+
+	free(lengths);
+	free(distances);
+	free(costs);
+	free(choices);
+	return cancelled ? -1 : 0;
+}
+
+int compressDataOptimal(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
+	if (allocateBuffers(size, dictionary, dictionarySize) != 0) {
+		return -1;
+	}
+	memcpy(&inputData[Format::windowSize], data, sizeof(uint8_t) * size);
+
+	if (compressBuffersOptimal() != 0) {
+		releaseBuffers(NULL);
+		return -1;
+	}
+	releaseBuffers(result);
 	return 0;
+}
+
+int compressDataStored(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
+	if (allocateBuffers(size, dictionary, dictionarySize) != 0) {
+		return -1;
+	}
+	memcpy(&inputData[Format::windowSize], data, sizeof(uint8_t) * size);
+
+	startOutput();
+	while (inputIndex < filesize + Format::windowSize) {
+		if (inputIndex >= nextProgress && reportProgress() != 0) {
+			releaseBuffers(NULL);
+			return -1;
+		}
+		writeLiteral();
+		++inputIndex;
+	}
+	finishOutput();
+
+	releaseBuffers(result);
+	return 0;
+}
+
+uint8_t *padData(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize) {
+	uint8_t *padded = allocateInput(size, dictionary, dictionarySize);
+	if (padded != NULL) {
+		memcpy(&padded[Format::windowSize], data, sizeof(uint8_t) * size);
+	}
+	return padded;
+}
+
+int compressPaddedData(const uint8_t *padded, uint32_t size, uint32_t dictionarySize, int strategy, CompressedData *result) {
+	// The encoders only read the input, so it is used where it is
+	filesize = size;
+	inputData = (uint8_t *)padded;
+	int status = allocateOutput();
+	if (status == 0) {
+		if (strategy == STRATEGY_LAZY) {
+			status = compressBuffersLazy(dictionarySize);
+		}
+		else if (strategy == STRATEGY_OPTIMAL) {
+			status = compressBuffersOptimal();
+		}
+		else {
+			status = compressBuffers(dictionarySize);
+		}
+	}
+
+	// Don't free or hand over the caller's input
+	inputData = NULL;
+	if (status != 0) {
+		releaseBuffers(NULL);
+		return -1;
+	}
+	releaseBuffers(result);
+	return 0;
+}
+
+int64_t estimateCompressedSize(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, int level) {
+	if (level == ESTIMATE_STORED) {
+		// The header and a control byte, then a byte per literal and a control byte after every 8 of them
+		return 9 + (int64_t)size + size / 8;
+	}
+	else if (level == ESTIMATE_FAST) {
+		return (int64_t)estimateCompressedSizeFast(data, size);
+	}
+
+	// Run the encoder, it only moves outputIndex along
+	CompressedData result;
+	countOnly = 1;
+	int status = level == ESTIMATE_OPTIMAL ?
+		compressDataOptimal(data, size, dictionary, dictionarySize, &result) :
+		compressData(data, size, dictionary, dictionarySize, &result);
+	countOnly = 0;
+	if (status != 0) {
+		return -1;
+	}
+	int64_t compressedSize = result.compressedSize;
+	freeCompressedData(&result);
+	return compressedSize;
+}
+
+int recompressData(const uint8_t *data, uint32_t size, const uint8_t *oldData, uint32_t oldSize, const uint8_t *oldCompressed, uint32_t oldCompressedSize, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result) {
+	// The old stream has to really be the old data, otherwise compress from scratch
+	LzHeader header;
+	if (readHeader(oldCompressed, oldCompressedSize, LZ_FORMAT_SMB, &header) != 0 || header.uncompressedSize != oldSize) {
+		puts("Base doesn't match its compressed file, compressing from scratch");
+		return compressData(data, size, dictionary, dictionarySize, result);
+	}
+	const uint8_t *oldInput = &oldCompressed[header.headerSize];
+
+	if (allocateBuffers(size, dictionary, dictionarySize) != 0) {
+		return -1;
+	}
+	memcpy(&inputData[Format::windowSize], data, sizeof(uint8_t) * size);
+
+	uint8_t *oldDecompressed = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)oldSize + 1));
+	if (oldDecompressed == NULL) {
+		puts("Unable to allocate memory");
+		releaseBuffers(NULL);
+		return -1;
+	}
+	int64_t matching = decompressData(oldInput, header.dataSize, oldDecompressed, oldSize, inputData, oldData);
+	free(oldDecompressed);
+	if (matching != (int64_t)oldSize) {
+		puts("Base doesn't match its compressed file, compressing from scratch");
+		releaseBuffers(NULL);
+		return compressData(data, size, dictionary, dictionarySize, result);
+	}
+
+	// Find the changed range
+	uint32_t minSize = size < oldSize ? size : oldSize;
+	uint32_t prefix = 0;
+	while (prefix < minSize && data[prefix] == oldData[prefix]) {
+		++prefix;
+	}
+	uint32_t suffix = 0;
+	while (suffix < minSize - prefix && data[size - 1 - suffix] == oldData[oldSize - 1 - suffix]) {
+		++suffix;
+	}
+
+	// Old tokens can be kept as long as all maxLength bytes the encoder looked at are unchanged
+	StreamPosition resume = { 0, 8, 0, 0 };
+	{
+		StreamPosition position = resume;
+		uint32_t length;
+		uint32_t backSet;
+		while (position.outputOffset + Format::maxLength <= prefix && readToken<Format>(oldInput, header.dataSize, &position, &length, &backSet) >= 0) {
+			resume = position;
+		}
+	}
+
+	// Copy the old stream up to there and pick up its control block
+	outputIndex = 8 + resume.dataOffset;
+	memcpy(&outputData[8], oldInput, resume.dataOffset);
+	if (resume.bit == 8) {
+		posInBlock = 0;
+		curBlock = 0;
+		// Make room for the next control block
+		++outputIndex;
+		blockBackset = 1;
+	}
+	else {
+		posInBlock = resume.bit;
+		curBlock = (uint8_t)(oldInput[resume.controlOffset] & Format::flagsBefore(resume.bit));
+		blockBackset = resume.dataOffset - resume.controlOffset;
+	}
+
+	resumeBinaryTree(Format::windowSize + resume.outputOffset, dictionarySize);
+	startProgress();
+
+	// Once the window is past the change, the old tokens are valid again at the same data
+	Resync resync;
+	resync.input = oldInput;
+	resync.inputSize = header.dataSize;
+	resync.position = resume;
+	resync.start = size - suffix + Format::windowSize;
+	resync.delta = size - oldSize;
+	encodeUntil(filesize + Format::windowSize, &resync);
+
+	// Re-encode the rest of the old tokens at their new position
+	uint32_t length;
+	uint32_t backSet;
+	int token;
+	while (!cancelled && inputIndex < filesize + Format::windowSize && (token = readToken<Format>(oldInput, header.dataSize, &resync.position, &length, &backSet)) >= 0) {
+		if (token == 1) {
+			writeReference(backSet, length);
+		}
+		else {
+			writeLiteral();
+		}
+		inputIndex += length;
+	}
+	finishOutput();
+
+	if (cancelled) {
+		releaseBuffers(NULL);
+		return -1;
+	}
+	releaseBuffers(result);
+	return 0;
+}
+
+void freeCompressedData(CompressedData *data) {
+	free(data->window);
+	free(data->compressed);
+	data->window = NULL;
+	data->compressed = NULL;
+	data->size = 0;
+	data->compressedSize = 0;
+}
+
+int64_t decompressData(const uint8_t *input, uint32_t inputSize, uint8_t *output, uint32_t outputSize, const uint8_t *window, const uint8_t *expected) {
+	// The stream starts with a control byte
+	StreamPosition start = { 0, 8, 0, 0 };
+	return decodeTokens<Format>(input, inputSize, start, output, outputSize, window, expected, 0);
+}
+
+int64_t decompressFrom(const uint8_t *input, uint32_t inputSize, StreamPosition start, uint8_t *output, uint32_t outputSize, const uint8_t *window) {
+	return decodeTokens<Format>(input, inputSize, start, output, outputSize, window, NULL, 1);
+}
+
+int64_t decompressedSize(const uint8_t *input, uint32_t inputSize) {
+	return decodedSize<Format>(input, inputSize);
+}
+
+int readHeader(const uint8_t *data, uint32_t size, int format, LzHeader *header) {
+	if (size < 4) {
+		return -1;
+	}
+	uint32_t firstInt = readLittleIntData(data, 0);
+
+	// The SMB header counts itself in the compressed size, the FF7 header doesn't
+	// Exact matches win over files with padding at the end
+	if (format == LZ_FORMAT_AUTO) {
+		if (size >= 8 && firstInt == size) {
+			format = LZ_FORMAT_SMB;
+		}
+		else if (firstInt + 4ull == size) {
+			format = LZ_FORMAT_FF7;
+		}
+		else if (size >= 8 && firstInt >= 8 && firstInt <= size) {
+			format = LZ_FORMAT_SMB;
+		}
+		else if (firstInt + 4ull <= size) {
+			format = LZ_FORMAT_FF7;
+		}
+		else {
+			return -1;
+		}
+	}
+
+	if (format == LZ_FORMAT_SMB) {
+		if (size < 8 || firstInt < 8 || firstInt > size) {
+			return -1;
+		}
+		// Don't trust a size the data can't possibly decode to
+		uint32_t uncompressedSize = readLittleIntData(data, 4);
+		if (uncompressedSize > Format::maxDecodedSize(firstInt - 8)) {
+			return -1;
+		}
+		header->format = LZ_FORMAT_SMB;
+		header->headerSize = 8;
+		header->dataSize = firstInt - 8;
+		header->uncompressedSize = uncompressedSize;
+		header->paddingSize = size - firstInt;
+		return 0;
+	}
+	else if (format == LZ_FORMAT_FF7) {
+		if (firstInt + 4ull > size) {
+			return -1;
+		}
+		// FF7 doesn't store the uncompressed size, so walk the data for it
+		int64_t uncompressedSize = decompressedSize(&data[4], firstInt);
+		if (uncompressedSize < 0 || uncompressedSize > 0xFFFFFFFFll) {
+			return -1;
+		}
+		header->format = LZ_FORMAT_FF7;
+		header->headerSize = 4;
+		header->dataSize = firstInt;
+		header->uncompressedSize = (uint32_t)uncompressedSize;
+		header->paddingSize = size - 4 - firstInt;
+		return 0;
+	}
+	return -1;
+}
+
+int64_t verifyCompressedData(const CompressedData *data) {
+	// The header has to read back (the same way decompressing reads it) as exactly the data
+	LzHeader header;
+	if (readHeader(data->compressed, data->compressedSize, LZ_FORMAT_SMB, &header) != 0 || header.paddingSize != 0 || header.uncompressedSize != data->size) {
+		return 0;
+	}
+
+	uint8_t *decompressed = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)data->size + 1));
+	if (decompressed == NULL) {
+		puts("Unable to allocate memory");
+		return VERIFY_OUT_OF_MEMORY;
+	}
+
+	int64_t matching = decompressData(&data->compressed[8], data->compressedSize - 8, decompressed, data->size, data->window, &data->window[Format::windowSize]);
+	free(decompressed);
+
+	// Running past the end counts as differing right after the data
+	if (matching < 0) {
+		return data->size;
+	}
+	if (matching != data->size) {
+		return matching;
+	}
+	return -1;
 }
\ No newline at end of file
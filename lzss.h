@@ -1,5 +1,133 @@
+#pragma once
 #include <stdio.h>
+#include <stdint.h>
+
+// Header formats of compressed files
+// SMB/F-Zero GX: Compressed size including the 8 byte header, then the uncompressed size
+// FF7: Compressed size not including the 4 byte header
+#define LZ_FORMAT_AUTO 0
+#define LZ_FORMAT_SMB 1
+#define LZ_FORMAT_FF7 2
+
+typedef struct {
+	int format;                // LZ_FORMAT_SMB or LZ_FORMAT_FF7
+	uint32_t headerSize;       // Where the LZSS data starts
+	uint32_t dataSize;         // Size of the LZSS data (without the header)
+	uint32_t uncompressedSize;
+	uint32_t paddingSize;      // Bytes after the LZSS data, up to the end of the file
+}LzHeader;
+
+// Position of a token in an LZSS stream (without the header)
+typedef struct {
+	uint32_t controlOffset;  // Where the token's control byte is
+	uint32_t bit;            // Which bit of the control byte is the token's (8 means the next byte is a new control byte)
+	uint32_t dataOffset;     // Where the token's data is
+	uint32_t outputOffset;   // How many bytes are decoded before the token
+}StreamPosition;
+
+typedef struct {
+	uint8_t *window;         // The window (Format::windowSize bytes) followed by the uncompressed data
+	uint32_t size;           // Size of the uncompressed data
+	uint8_t *compressed;     // The compressed data including the header
+	uint32_t compressedSize; // Size of the compressed data including the header
+}CompressedData;
+
+// Called about every 64 KB of input while compressing, with how many bytes have been read and written so far
+// Returning nonzero stops the compression, which then fails (returns -1)
+typedef int (*ProgressCallback)(uint32_t bytesIn, uint32_t bytesOut, uint32_t totalIn, void *userData);
+
+// Sets the progress callback for compressing on the calling thread (NULL for none)
+void setProgressCallback(ProgressCallback callback, void *userData);
 
 int compressFile(char *filename);
 
-int compress(FILE *input, FILE *output);
\ No newline at end of file
+int compress(FILE *input, FILE *output);
+
+// The dictionary pre-fills the end of the window (only the last Format::windowSize bytes are used)
+// The same dictionary has to be given when decompressing
+int compressFileWithDictionary(char *filename, const uint8_t *dictionary, uint32_t dictionarySize);
+
+int compressWithDictionary(FILE *input, FILE *output, const uint8_t *dictionary, uint32_t dictionarySize);
+
+// Same as the dictionary versions, but the buffers are handed over to result (if not NULL) instead of being freed
+int compressFileAndKeep(char *filename, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+int compressAndKeep(FILE *input, FILE *output, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+// Compresses data that is already in memory, the buffers are always handed over to result
+int compressData(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+// Same as compressData, but writes a literal instead of a reference when the reference at the next byte is longer
+// Usually a little smaller, in about the same time
+int compressDataLazy(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+// Same as compressData, but picks the tokens that give the smallest output (exact up to the last control byte)
+// instead of the longest match every time, using a suffix array to find the matches
+// Slower and needs about 22 times the size in memory, meant for offline builds
+int compressDataOptimal(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+// Writes the data as a stream of literals only (1/8 bigger than the data, but a valid compressed file)
+// For data that doesn't compress anyway, this skips all of the searching
+int compressDataStored(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+// Encoders compressPaddedData can run, and best races (ties go to the first one)
+#define STRATEGY_GREEDY 0   // compressData
+#define STRATEGY_LAZY 1     // compressDataLazy
+#define STRATEGY_OPTIMAL 2  // compressDataOptimal
+#define STRATEGY_COUNT 3
+
+// Builds the input the encoders work on: the window (zeros, then the end of the dictionary), the data,
+// then Format::maxLength zeros so matches near the end stay in bounds
+// Returns NULL if out of memory, otherwise free it when done
+uint8_t *padData(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize);
+
+// Compresses a buffer from padData with one of the STRATEGY_* encoders without copying it
+// The buffer is only read, so several threads can compress the same one at once
+// result->window is left NULL, the buffer stays the caller's
+int compressPaddedData(const uint8_t *padded, uint32_t size, uint32_t dictionarySize, int strategy, CompressedData *result);
+
+// How estimateCompressedSize gets the size
+#define ESTIMATE_GREEDY 0   // What compressData writes (runs the same encoder)
+#define ESTIMATE_OPTIMAL 1  // What compressDataOptimal writes (runs the same encoder)
+#define ESTIMATE_STORED 2   // What compressDataStored writes (just arithmetic)
+#define ESTIMATE_FAST 3     // An upper bound from greedy hash matches (see estimateCompressedSizeFast in probe.h), many times faster
+
+// Size of the compressed file (header included) that compressing would give, without writing any output
+// The exact levels have the same progress callback and memory use as compressing, minus the output buffer
+// Returns -1 if out of memory or cancelled
+int64_t estimateCompressedSize(const uint8_t *data, uint32_t size, const uint8_t *dictionary, uint32_t dictionarySize, int level);
+
+// Compresses data that changed from oldData, reusing oldCompressed (compressed from oldData with the same dictionary)
+// for everything before the first change and for everything more than a window after the last change
+// Falls back to compressing from scratch if oldCompressed isn't oldData
+int recompressData(const uint8_t *data, uint32_t size, const uint8_t *oldData, uint32_t oldSize, const uint8_t *oldCompressed, uint32_t oldCompressedSize, const uint8_t *dictionary, uint32_t dictionarySize, CompressedData *result);
+
+void freeCompressedData(CompressedData *data);
+
+// Decodes an LZSS stream (without a header) into output
+// References before the start of the output are read from the window (Format::windowSize bytes)
+// If expected is not NULL, decoding stops at the first byte that differs from it
+// Returns the number of bytes decoded (and matching), or -1 if the stream doesn't fit in the output
+int64_t decompressData(const uint8_t *input, uint32_t inputSize, uint8_t *output, uint32_t outputSize, const uint8_t *window, const uint8_t *expected);
+
+// Decodes from a token in the middle of an LZSS stream until output is full or the stream ends
+// The window has to hold the Format::windowSize bytes decoded before the token
+// Returns the number of bytes decoded, or -1 if the stream is cut off
+int64_t decompressFrom(const uint8_t *input, uint32_t inputSize, StreamPosition start, uint8_t *output, uint32_t outputSize, const uint8_t *window);
+
+// Returned by verifyCompressedData when there isn't enough memory to decode into
+#define VERIFY_OUT_OF_MEMORY -2
+
+// Decodes the compressed data in memory and compares it against the uncompressed data
+// Returns the offset of the first difference, -1 if it round trips, or VERIFY_OUT_OF_MEMORY
+int64_t verifyCompressedData(const CompressedData *data);
+
+// Walks an LZSS stream (without a header) and returns the size it decompresses to, or -1 if it is cut off
+int64_t decompressedSize(const uint8_t *input, uint32_t inputSize);
+
+// Parses the header at the start of a compressed file of the given size
+// LZ_FORMAT_AUTO picks the format whose compressed size fits the file size
+// Bytes after the compressed data are padding, paddingSize says how many
+// Returns 0 on success, or -1 if the header doesn't fit the format(s)
+// or claims more uncompressed data than the stream can hold
+int readHeader(const uint8_t *data, uint32_t size, int format, LzHeader *header);
\ No newline at end of file
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "lzss.h"
+#include "FunctionsAndDefines.h"
+
+/*
+* Compile time description of an LZSS stream
+* Control bytes hold one flag per token, 1 for a literal and 0 for a reference
+* A reference is 2 bytes: the low 8 bits of the offset, then the rest of the offset above (length - minLength)
+* The offset is a position in a ring buffer that starts offsetBias bytes before its end
+* Everything is a constant, so code using it compiles down to the same thing as hard-coded numbers
+*/
+template <uint32_t WindowBits, uint32_t LengthBits, uint32_t MinLength, uint32_t OffsetBias, bool MsbFirstFlags>
+struct LzssFormat {
+	static_assert(WindowBits >= 8 && WindowBits + LengthBits == 16, "References have to fit in 2 bytes");
+
+	static const uint32_t windowSize = 1u << WindowBits;
+	static const uint32_t windowMask = windowSize - 1;
+	static const uint32_t lengthBits = LengthBits;
+	static const uint32_t lengthMask = (1u << LengthBits) - 1;
+	static const uint32_t minLength = MinLength;
+	static const uint32_t maxLength = MinLength + lengthMask;
+	static const uint32_t offsetBias = OffsetBias;
+
+	// The control byte bit of the nth token in a block
+	static inline uint8_t flagMask(uint32_t n) {
+		return (uint8_t)(MsbFirstFlags ? 0x80 >> n : 0x01 << n);
+	}
+
+	// The control byte bits of the first n tokens in a block
+	static inline uint8_t flagsBefore(uint32_t n) {
+		return (uint8_t)(MsbFirstFlags ? ~(0xFF >> n) : (1 << n) - 1);
+	}
+
+	// Makes a reference at position (in the whole output) to the data backSet bytes before it
+	static inline uint16_t packReference(uint32_t position, uint32_t backSet, uint32_t length) {
+		uint32_t offset = (position - offsetBias - backSet) & windowMask;
+		return (uint16_t)(((offset & 0xFF) << 8) | ((offset >> 8) << LengthBits) | ((length - minLength) & lengthMask));
+	}
+
+	static inline uint32_t referenceLength(uint16_t reference) {
+		return (reference & lengthMask) + minLength;
+	}
+
+	// How many bytes before position (in the whole output) the reference starts
+	static inline uint32_t referenceBackSet(uint16_t reference, uint32_t position) {
+		uint32_t offset = (reference >> 8) | (((reference & 0xFF) >> LengthBits) << 8);
+		return (position - offsetBias - offset) & windowMask;
+	}
+
+	// The most a stream of the given size can decode to (every token a longest reference,
+	// except a literal in the last block when its data has an odd byte left)
+	static inline uint64_t maxDecodedSize(uint64_t streamSize) {
+		uint64_t blockSize = 1 + 8 * 2;
+		uint64_t rest = streamSize % blockSize;
+		return streamSize / blockSize * 8 * maxLength + (rest > 0 ? (rest - 1) / 2 * maxLength + ((rest - 1) & 1) : 0);
+	}
+};
+
+// The stream in FF7 and SMB/F-Zero GX files (they only differ in the header, see readHeader)
+// 4096 byte window, 3-18 byte references, ring buffer starting at 0xFEE, LSB first flags
+typedef LzssFormat<12, 4, 3, 18, false> Ff7Lzss;
+
+// The stream format the encoder, the decoder and every tool are built for
+typedef Ff7Lzss Format;
+
+/*
+* Reads the token at the position and moves the position past it
+* Returns 1 for a reference (with its length and backSet), 0 for a literal (length 1), or -1 at the end of the stream
+*/
+template <class Format>
+static inline int readToken(const uint8_t *input, uint32_t inputSize, StreamPosition *position, uint32_t *length, uint32_t *backSet) {
+	if (position->bit == 8) {
+		if (position->dataOffset >= inputSize) {
+			return -1;
+		}
+		position->controlOffset = position->dataOffset++;
+		position->bit = 0;
+	}
+	if (position->dataOffset >= inputSize) {
+		return -1;
+	}
+
+	int isReference = !(input[position->controlOffset] & Format::flagMask(position->bit));
+	if (isReference) {
+		if (position->dataOffset + 2 > inputSize) {
+			return -1;
+		}
+		uint16_t reference = readBigShortData(input, position->dataOffset);
+		*length = Format::referenceLength(reference);
+		*backSet = Format::referenceBackSet(reference, position->outputOffset);
+		position->dataOffset += 2;
+	}
+	else {
+		*length = 1;
+		*backSet = 0;
+		position->dataOffset++;
+	}
+
+	position->outputOffset += *length;
+	position->bit++;
+	return isReference;
+}
+
+/*
+* Decodes tokens from the given position in the LZSS stream into output
+* The window holds the Format::windowSize bytes decoded before output[0]
+* If expected is not NULL, decoding stops at the first byte that differs from it
+* If stopWhenFull is set, decoding stops once the output is full, otherwise data past the end is an error
+*/
+template <class Format>
+static int64_t decodeTokens(const uint8_t *input, uint32_t inputSize, StreamPosition start, uint8_t *output, uint32_t outputSize, const uint8_t *window, const uint8_t *expected, int stopWhenFull) {
+	uint32_t controlOffset = start.controlOffset;
+	uint32_t bit = start.bit;
+	uint32_t inputPosition = start.dataOffset;
+	uint32_t outputPosition = 0;
+
+	// Loop until we reach the end of the data
+	while (inputPosition < inputSize) {
+		// Each bit of a control block specifies how the the next 8 spots of data will be
+		// 1 means write the byte directly to the output
+		// 0 represents there will be reference (2 byte)
+		if (bit == 8) {
+			controlOffset = inputPosition++;
+			bit = 0;
+			continue;
+		}
+		if (stopWhenFull && outputPosition == outputSize) {
+			break;
+		}
+
+		uint32_t tokenStart = outputPosition;
+
+		// Literal byte copy
+		if (input[controlOffset] & Format::flagMask(bit)) {
+			if (outputPosition == outputSize) {
+				return -1;
+			}
+			output[outputPosition++] = input[inputPosition++];
+		}// Reference
+		else {
+			if (inputPosition + 2 > inputSize) {
+				return -1;
+			}
+			uint16_t reference = readBigShortData(input, inputPosition);
+			inputPosition += 2;
+
+			uint32_t length = Format::referenceLength(reference);
+
+			// Convert the offset to how many bytes away from the end of the output to start reading from
+			// (The offset is relative to the position in the whole file)
+			uint32_t backSet = Format::referenceBackSet(reference, start.outputOffset + outputPosition);
+			int64_t readLocation = (int64_t)outputPosition - backSet;
+
+			if (length > outputSize - outputPosition) {
+				if (!stopWhenFull) {
+					return -1;
+				}
+				length = outputSize - outputPosition;
+			}
+
+			// The part before the start of the output comes from the window
+			while (readLocation < 0 && length > 0) {
+				output[outputPosition++] = window[Format::windowSize + readLocation++];
+				--length;
+			}
+
+			// Copy the rest of the reference bytes
+			while (length-- > 0) {
+				output[outputPosition++] = output[readLocation++];
+			}
+		}
+
+		// Stop at the first byte that doesn't match
+		if (expected != NULL) {
+			for (uint32_t i = tokenStart; i < outputPosition; i++) {
+				if (output[i] != expected[i]) {
+					return i;
+				}
+			}
+		}
+
+		// Go to the next reference bit in the block
+		++bit;
+	}
+
+	return outputPosition;
+}
+
+/*
+* Adds up the lengths of the tokens in the stream without decoding them
+* Returns -1 if the stream ends in the middle of a reference
+*/
+template <class Format>
+static int64_t decodedSize(const uint8_t *input, uint32_t inputSize) {
+	uint32_t inputPosition = 0;
+	int64_t outputSize = 0;
+
+	while (inputPosition < inputSize) {
+		uint8_t block = input[inputPosition++];
+
+		for (uint32_t j = 0; j < 8 && inputPosition < inputSize; ++j) {
+			if (block & Format::flagMask(j)) {
+				++inputPosition;
+				++outputSize;
+			}
+			else {
+				if (inputPosition + 2 > inputSize) {
+					return -1;
+				}
+				outputSize += Format::referenceLength(readBigShortData(input, inputPosition));
+				inputPosition += 2;
+			}
+		}
+	}
+
+	return outputSize;
+}
@@ -0,0 +1,179 @@
+#include "probe.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lzssformat.h"
+
+// Blocks of the data that get matched, spread evenly over it
+#define PROBE_BLOCKS 32
+#define PROBE_BLOCK_SIZE 4096
+#define PROBE_HASH_BITS 12
+
+// The fast estimate follows hash chains like a real match finder, up to this many candidates a position
+#define ESTIMATE_HASH_BITS 16
+#define ESTIMATE_CHAIN_DEPTH 16
+
+// Below this many bits per byte there is too much repetition to call the data incompressible
+#define PROBE_MIN_ENTROPY 7.0
+
+static uint32_t hashBytes(const uint8_t *data, int bits) {
+	uint32_t value = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+	return (value * 2654435761u) >> (32 - bits);
+}
+
+/*
+* Greedily matches data from start to end against the last position with the same hash
+* The table has to already have the positions before start that can be referenced
+* Counts the tokens and returns where matching stopped (a match can run past end)
+*/
+static uint32_t matchGreedy(const uint8_t *data, uint32_t size, uint32_t start, uint32_t end, uint32_t *table, uint64_t *literals, uint64_t *references) {
+	uint32_t position = start;
+	while (position < end) {
+		uint32_t length = 0;
+		if (position + 2 < size) {
+			uint32_t hash = hashBytes(&data[position], PROBE_HASH_BITS);
+			uint32_t candidate = table[hash];
+			table[hash] = position + 1;
+			if (candidate != 0 && position - (candidate - 1) < Format::windowSize) {
+				uint32_t limit = size - position < Format::maxLength ? size - position : Format::maxLength;
+				while (length < limit && data[candidate - 1 + length] == data[position + length]) {
+					++length;
+				}
+			}
+		}
+
+		if (length >= Format::minLength) {
+			++*references;
+			for (uint32_t i = 1; i < length && position + i + 2 < size; i++) {
+				table[hashBytes(&data[position + i], PROBE_HASH_BITS)] = position + i + 1;
+			}
+			position += length;
+		}
+		else {
+			++*literals;
+			++position;
+		}
+	}
+	return position;
+}
+
+ProbeResult probeCompressibility(const uint8_t *data, uint32_t size) {
+	ProbeResult result = { 0.0, 1.0 };
+	if (size == 0) {
+		return result;
+	}
+
+	uint32_t counts[256] = { 0 };
+	for (uint32_t i = 0; i < size; i++) {
+		counts[data[i]]++;
+	}
+	for (int i = 0; i < 256; i++) {
+		if (counts[i] > 0) {
+			double probability = (double)counts[i] / size;
+			result.entropy -= probability * log2(probability);
+		}
+	}
+
+	// Small files are covered completely
+	uint32_t blockCount = (size + PROBE_BLOCK_SIZE - 1) / PROBE_BLOCK_SIZE;
+	if (blockCount > PROBE_BLOCKS) {
+		blockCount = PROBE_BLOCKS;
+	}
+	uint32_t spacing = size / blockCount;
+
+	// Last position seen with each hash (+1, so 0 is empty)
+	uint32_t table[1 << PROBE_HASH_BITS];
+	uint64_t literals = 0;
+	uint64_t references = 0;
+	uint64_t sampled = 0;
+	for (uint32_t block = 0; block < blockCount; block++) {
+		uint32_t start = block * spacing;
+		uint32_t end = size - start < PROBE_BLOCK_SIZE ? size : start + PROBE_BLOCK_SIZE;
+		memset(table, 0, sizeof(table));
+
+		// The window before the block can be referenced too
+		uint32_t position = start > Format::windowSize ? start - Format::windowSize : 0;
+		for (; position < start && position + 2 < size; position++) {
+			table[hashBytes(&data[position], PROBE_HASH_BITS)] = position + 1;
+		}
+
+		sampled += matchGreedy(data, size, start, end, table, &literals, &references) - start;
+	}
+
+	// A literal is a flag and a byte, a reference is a flag and 2 bytes
+	result.ratio = (double)(literals * 9 + references * 17) / (8.0 * sampled);
+	return result;
+}
+
+/*
+* Makes position the newest one with its hash, chained to the one before it
+*/
+static void insertPosition(const uint8_t *data, uint32_t size, uint32_t position, uint32_t *heads, uint32_t *previous) {
+	if (position + 2 < size) {
+		uint32_t hash = hashBytes(&data[position], ESTIMATE_HASH_BITS);
+		previous[position & Format::windowMask] = heads[hash];
+		heads[hash] = position + 1;
+	}
+}
+
+uint64_t estimateCompressedSizeFast(const uint8_t *data, uint32_t size) {
+	// Newest position (+1, so 0 is empty) with each hash, and the one before it with the same hash
+	// A chain only ever goes back a window, so previous is a ring buffer
+	uint32_t *heads = (uint32_t *)calloc((size_t)1 << ESTIMATE_HASH_BITS, sizeof(uint32_t));
+	uint32_t *previous = (uint32_t *)malloc(sizeof(uint32_t) * Format::windowSize);
+	if (heads == NULL || previous == NULL) {
+		// All literals is still an upper bound
+		free(heads);
+		free(previous);
+		return 9 + (uint64_t)size + size / 8;
+	}
+
+	uint64_t literals = 0;
+	uint64_t references = 0;
+	uint32_t position = 0;
+	while (position < size) {
+		// Longest match among the newest candidates in the window
+		uint32_t bestLength = 0;
+		if (position + 2 < size) {
+			uint32_t limit = size - position < Format::maxLength ? size - position : Format::maxLength;
+			uint32_t candidate = heads[hashBytes(&data[position], ESTIMATE_HASH_BITS)];
+			for (int depth = 0; depth < ESTIMATE_CHAIN_DEPTH && candidate != 0 && position - (candidate - 1) < Format::windowSize; depth++) {
+				const uint8_t *match = &data[candidate - 1];
+				uint32_t length = 0;
+				while (length < limit && match[length] == data[position + length]) {
+					++length;
+				}
+				if (length > bestLength) {
+					bestLength = length;
+					if (length == limit) {
+						break;
+					}
+				}
+				candidate = previous[(candidate - 1) & Format::windowMask];
+			}
+		}
+
+		uint32_t length = bestLength >= Format::minLength ? bestLength : 1;
+		if (length > 1) {
+			++references;
+		}
+		else {
+			++literals;
+		}
+		for (uint32_t i = 0; i < length; i++) {
+			insertPosition(data, size, position + i, heads, previous);
+		}
+		position += length;
+	}
+	free(heads);
+	free(previous);
+
+	// Laid out like the encoder does it: the header and a control byte, then another control byte after every 8 tokens
+	return 9 + literals + references * 2 + (literals + references) / 8;
+}
+
+int isCompressible(const ProbeResult *probe, double maxRatio) {
+	return probe->ratio < maxRatio || probe->entropy < PROBE_MIN_ENTROPY;
+}
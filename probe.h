@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+	double entropy;  // Bits per byte, from the byte counts of the whole data
+	double ratio;    // Compressed size / size of sampled blocks, with greedy matches from a hash table
+}ProbeResult;
+
+// Estimates how well data compresses in a small fraction of the time compressing takes
+// The ratio counts the format's flag bits, so data without matches comes out at 1.125
+ProbeResult probeCompressibility(const uint8_t *data, uint32_t size);
+
+// Size of the compressed file (header included) from greedy matches over all of the data, found with hash chains
+// The matches are real ones, so it never comes out below what compressDataOptimal gives (give or take a control byte)
+// Usually within a few percent of what compressData gives
+uint64_t estimateCompressedSizeFast(const uint8_t *data, uint32_t size);
+
+// Whether data is expected to compress to less than maxRatio of its size
+// Data with low entropy counts as compressible even if the samples missed its matches
+int isCompressible(const ProbeResult *probe, double maxRatio);
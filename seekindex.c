@@ -0,0 +1,212 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "seekindex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FunctionsAndDefines.h"
+#include "lzssformat.h"
+
+// Sidecar layout (all little endian)
+// Header: "LZIX", interval, uncompressed size, checkpoint count
+// Checkpoint: control offset, bit, data offset, output offset, Format::windowSize byte window
+static const uint8_t indexMagic[4] = { 'L', 'Z', 'I', 'X' };
+#define INDEX_HEADER_SIZE 16
+#define INDEX_CHECKPOINT_SIZE (16 + Format::windowSize)
+
+int buildSeekIndex(const uint8_t *input, uint32_t inputSize, const uint8_t *output, uint32_t outputSize, const uint8_t *window, uint32_t interval, SeekIndex *index) {
+	if (interval == 0) {
+		return -1;
+	}
+
+	index->interval = interval;
+	index->uncompressedSize = outputSize;
+	index->count = 0;
+	index->checkpoints = (SeekCheckpoint *)malloc(sizeof(SeekCheckpoint) * (outputSize / interval + 1));
+	if (index->checkpoints == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+
+	StreamPosition position = { 0, 8, 0, 0 };
+	uint64_t nextCheckpoint = 0;
+
+	// Same walk as decompressData, but only follows the positions
+	uint32_t length;
+	uint32_t backSet;
+	int isReference;
+	while ((isReference = readToken<Format>(input, inputSize, &position, &length, &backSet)) >= 0) {
+		// Running past the output means this isn't the right stream
+		if (position.outputOffset > outputSize) {
+			break;
+		}
+
+		// Record the first token at or after the next multiple of the interval
+		uint32_t outputPosition = position.outputOffset - length;
+		if (outputPosition >= nextCheckpoint) {
+			SeekCheckpoint *checkpoint = &index->checkpoints[index->count++];
+			checkpoint->position.controlOffset = position.controlOffset;
+			checkpoint->position.bit = position.bit - 1;
+			checkpoint->position.dataOffset = position.dataOffset - (isReference ? 2 : 1);
+			checkpoint->position.outputOffset = outputPosition;
+
+			// The window is the end of the starting window followed by the output so far
+			if (outputPosition < Format::windowSize) {
+				memcpy(checkpoint->window, &window[outputPosition], Format::windowSize - outputPosition);
+				memcpy(&checkpoint->window[Format::windowSize - outputPosition], output, outputPosition);
+			}
+			else {
+				memcpy(checkpoint->window, &output[outputPosition - Format::windowSize], Format::windowSize);
+			}
+
+			while (nextCheckpoint <= outputPosition) {
+				nextCheckpoint += interval;
+			}
+		}
+	}
+
+	if (position.dataOffset != inputSize || position.outputOffset != outputSize) {
+		freeSeekIndex(index);
+		return -1;
+	}
+	return 0;
+}
+
+int saveSeekIndex(const SeekIndex *index, const char *filename) {
+	uint32_t size = INDEX_HEADER_SIZE + index->count * INDEX_CHECKPOINT_SIZE;
+	uint8_t *data = (uint8_t *)malloc(sizeof(uint8_t) * size);
+	if (data == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+
+	memcpy(data, indexMagic, sizeof(indexMagic));
+	writeLittleIntData(data, 4, index->interval);
+	writeLittleIntData(data, 8, index->uncompressedSize);
+	writeLittleIntData(data, 12, index->count);
+	for (uint32_t i = 0; i < index->count; i++) {
+		const SeekCheckpoint *checkpoint = &index->checkpoints[i];
+		uint32_t offset = INDEX_HEADER_SIZE + i * INDEX_CHECKPOINT_SIZE;
+		writeLittleIntData(data, offset, checkpoint->position.controlOffset);
+		writeLittleIntData(data, offset + 4, checkpoint->position.bit);
+		writeLittleIntData(data, offset + 8, checkpoint->position.dataOffset);
+		writeLittleIntData(data, offset + 12, checkpoint->position.outputOffset);
+		memcpy(&data[offset + 16], checkpoint->window, Format::windowSize);
+	}
+
+	FILE *file = fopen(filename, "wb");
+	if (file == NULL) {
+		printf("ERROR: Unable to open output file: %s\n", filename);
+		free(data);
+		return -1;
+	}
+	size_t written = fwrite(data, sizeof(uint8_t), size, file);
+	fclose(file);
+	free(data);
+	return written == size ? 0 : -1;
+}
+
+int loadSeekIndex(const char *filename, SeekIndex *index) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		printf("ERROR: File not found: %s\n", filename);
+		return -1;
+	}
+
+	// Read the whole file at once
+	fseek(file, 0, SEEK_END);
+	uint32_t size = (uint32_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t *data = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)size + 1));
+	if (data == NULL) {
+		puts("Unable to allocate memory");
+		fclose(file);
+		return -1;
+	}
+	size = (uint32_t)fread(data, sizeof(uint8_t), size, file);
+	fclose(file);
+
+	if (size < INDEX_HEADER_SIZE || memcmp(data, indexMagic, sizeof(indexMagic)) != 0) {
+		printf("ERROR: Not a seek index: %s\n", filename);
+		free(data);
+		return -1;
+	}
+
+	index->interval = readLittleIntData(data, 4);
+	index->uncompressedSize = readLittleIntData(data, 8);
+	index->count = readLittleIntData(data, 12);
+	if ((uint64_t)index->count * INDEX_CHECKPOINT_SIZE != size - INDEX_HEADER_SIZE) {
+		printf("ERROR: Seek index is cut off: %s\n", filename);
+		free(data);
+		return -1;
+	}
+
+	index->checkpoints = (SeekCheckpoint *)malloc(sizeof(SeekCheckpoint) * index->count);
+	if (index->checkpoints == NULL) {
+		puts("Unable to allocate memory");
+		free(data);
+		return -1;
+	}
+	for (uint32_t i = 0; i < index->count; i++) {
+		SeekCheckpoint *checkpoint = &index->checkpoints[i];
+		uint32_t offset = INDEX_HEADER_SIZE + i * INDEX_CHECKPOINT_SIZE;
+		checkpoint->position.controlOffset = readLittleIntData(data, offset);
+		checkpoint->position.bit = readLittleIntData(data, offset + 4);
+		checkpoint->position.dataOffset = readLittleIntData(data, offset + 8);
+		checkpoint->position.outputOffset = readLittleIntData(data, offset + 12);
+		memcpy(checkpoint->window, &data[offset + 16], Format::windowSize);
+	}
+
+	free(data);
+	return 0;
+}
+
+void freeSeekIndex(SeekIndex *index) {
+	free(index->checkpoints);
+	index->checkpoints = NULL;
+	index->count = 0;
+}
+
+int64_t decompressRange(const SeekIndex *index, const uint8_t *input, uint32_t inputSize, uint32_t offset, uint32_t length, uint8_t *output) {
+	if (index->count == 0 || offset >= index->uncompressedSize) {
+		return 0;
+	}
+	if (length > index->uncompressedSize - offset) {
+		length = index->uncompressedSize - offset;
+	}
+
+	// Binary search for the last checkpoint at or before the offset
+	uint32_t low = 0;
+	uint32_t high = index->count - 1;
+	while (low < high) {
+		uint32_t middle = (low + high + 1) / 2;
+		if (index->checkpoints[middle].position.outputOffset <= offset) {
+			low = middle;
+		}
+		else {
+			high = middle - 1;
+		}
+	}
+	const SeekCheckpoint *checkpoint = &index->checkpoints[low];
+
+	// Decode from the checkpoint to the end of the range, then copy out the range
+	uint32_t skip = offset - checkpoint->position.outputOffset;
+	uint8_t *decoded = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)skip + length + 1));
+	if (decoded == NULL) {
+		puts("Unable to allocate memory");
+		return -1;
+	}
+	int64_t decodedSize = decompressFrom(input, inputSize, checkpoint->position, decoded, skip + length, checkpoint->window);
+	if (decodedSize < (int64_t)(skip + length)) {
+		free(decoded);
+		return -1;
+	}
+
+	memcpy(output, &decoded[skip], length);
+	free(decoded);
+	return length;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+
+#include "lzss.h"
+#include "lzssformat.h"
+
+// Default distance between checkpoints in the uncompressed data
+#define SEEK_INDEX_INTERVAL 0x10000
+
+typedef struct {
+	StreamPosition position;  // First token at or after a multiple of the interval
+	uint8_t window[Format::windowSize];  // The window of bytes decoded before the token
+}SeekCheckpoint;
+
+typedef struct {
+	uint32_t interval;
+	uint32_t uncompressedSize;
+	uint32_t count;
+	SeekCheckpoint *checkpoints;
+}SeekIndex;
+
+// Walks an LZSS stream (without the header) and records a checkpoint every interval bytes of output
+// output is the decompressed data and window the Format::windowSize bytes before it (zeros, or zeros followed by a dictionary)
+// Returns 0 on success, or -1 if the stream doesn't match the output
+int buildSeekIndex(const uint8_t *input, uint32_t inputSize, const uint8_t *output, uint32_t outputSize, const uint8_t *window, uint32_t interval, SeekIndex *index);
+
+// Reads/writes the index as a sidecar file, returns 0 on success or -1 on failure
+int saveSeekIndex(const SeekIndex *index, const char *filename);
+
+int loadSeekIndex(const char *filename, SeekIndex *index);
+
+void freeSeekIndex(SeekIndex *index);
+
+// Decompresses length bytes starting at offset, starting from the closest checkpoint before it
+// input is the LZSS stream (without the header) the index was built from
+// Returns the number of bytes decompressed (less than length at the end of the data), or -1 if the stream is cut off
+int64_t decompressRange(const SeekIndex *index, const uint8_t *input, uint32_t inputSize, uint32_t offset, uint32_t length, uint8_t *output);
\ No newline at end of file
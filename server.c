@@ -0,0 +1,370 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FunctionsAndDefines.h"
+
+#ifndef _WIN32
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Messages (all little endian)
+// Request: type, mode, size, then size bytes (a file path, or the data)
+// Response: status (0 or 1 for failed), microseconds, size, then size bytes of data
+// A check response's data is the CRC-32, then the uncompressed size
+#define MESSAGE_HEADER_SIZE 12
+
+/*
+* Reads exactly size bytes, returns -1 if the connection closes first
+*/
+static int readAll(int socketFd, uint8_t *data, uint32_t size) {
+	while (size > 0) {
+		ssize_t count = read(socketFd, data, size);
+		if (count <= 0) {
+			return -1;
+		}
+		data += count;
+		size -= (uint32_t)count;
+	}
+	return 0;
+}
+
+static int writeAll(int socketFd, const uint8_t *data, uint32_t size) {
+	while (size > 0) {
+		ssize_t count = write(socketFd, data, size);
+		if (count <= 0) {
+			return -1;
+		}
+		data += count;
+		size -= (uint32_t)count;
+	}
+	return 0;
+}
+
+/*
+* Fills in the socket address, returns -1 if the path doesn't fit
+*/
+static int makeAddress(const char *socketPath, struct sockaddr_un *address) {
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(address->sun_path)) {
+		printf("ERROR: Socket path is too long: %s\n", socketPath);
+		return -1;
+	}
+	strcpy(address->sun_path, socketPath);
+	return 0;
+}
+
+static uint64_t currentMicroseconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+* Runs one request through the same stages as a command line job
+* data is the path or the data itself, result gets the data to send back (if any)
+*/
+static int handleRequest(const Job *options, int type, int mode, uint8_t *data, uint32_t size, uint8_t **result, uint32_t *resultSize) {
+	Job job = *options;
+	job.type = type == SERVER_COMPRESS ? JOB_COMPRESS : (type == SERVER_CHECK ? JOB_CHECK : JOB_DECOMPRESS);
+	// Verifying and checking only decode, so there is nothing to index
+	if (type == SERVER_VERIFY || type == SERVER_CHECK) {
+		job.writeIndex = 0;
+	}
+
+	if (mode == SERVER_PATH) {
+		data[size] = '\0';
+		snprintf(job.filename, sizeof(job.filename), "%s", (char *)data);
+		readJob(&job);
+	}
+	else {
+		// Inline data can't have an index file next to it
+		snprintf(job.filename, sizeof(job.filename), "(inline data)");
+		job.writeIndex = 0;
+		job.input = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)size + 1));
+		if (job.input == NULL) {
+			puts("Unable to allocate memory");
+			return -1;
+		}
+		memcpy(job.input, data, size);
+		job.inputSize = size;
+	}
+	processJob(&job);
+
+	// Path requests write their output like the command line does
+	if (mode == SERVER_PATH && (type == SERVER_COMPRESS || type == SERVER_DECOMPRESS)) {
+		return writeJob(&job);
+	}
+
+	if (!job.failed && type == SERVER_COMPRESS) {
+		int64_t difference = job.verify ? verifyCompressedData(&job.compressed) : -1;
+		if (difference == VERIFY_OUT_OF_MEMORY) {
+			printf("ERROR: Not enough memory to verify %s\n", job.filename);
+			job.failed = 1;
+		}
+		else if (difference != -1) {
+			printf("ERROR: Verification failed for %s\n", job.filename);
+			job.failed = 1;
+		}
+		else {
+			// Hand the compressed data over instead of copying it
+			*result = job.compressed.compressed;
+			*resultSize = job.compressed.compressedSize;
+			job.compressed.compressed = NULL;
+		}
+	}
+	else if (!job.failed && type == SERVER_DECOMPRESS) {
+		*result = job.output;
+		*resultSize = job.outputSize;
+		job.output = NULL;
+	}
+	else if (!job.failed && type == SERVER_CHECK) {
+		*result = (uint8_t *)malloc(sizeof(uint8_t) * 8);
+		if (*result == NULL) {
+			puts("Unable to allocate memory");
+			job.failed = 1;
+		}
+		else {
+			writeLittleIntData(*result, 0, job.checksum);
+			writeLittleIntData(*result, 4, job.outputSize);
+			*resultSize = 8;
+		}
+	}
+	else if (!job.failed) {
+		printf("Verified %s\n", job.filename);
+	}
+
+	free(job.output);
+	freeCompressedData(&job.compressed);
+	freeSeekIndex(&job.seekIndex);
+	return job.failed ? -1 : 0;
+}
+
+/*
+* Answers requests on the connection until the client closes it
+*/
+static void serveConnection(int connectionFd, const Job *options) {
+	uint8_t header[MESSAGE_HEADER_SIZE];
+	while (readAll(connectionFd, header, MESSAGE_HEADER_SIZE) == 0) {
+		int type = (int)readLittleIntData(header, 0);
+		int mode = (int)readLittleIntData(header, 4);
+		uint32_t size = readLittleIntData(header, 8);
+
+		// Room for the end of the path
+		uint8_t *data = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)size + 1));
+		if (data == NULL) {
+			puts("Unable to allocate memory");
+			return;
+		}
+		if (readAll(connectionFd, data, size) != 0) {
+			free(data);
+			return;
+		}
+
+		uint64_t start = currentMicroseconds();
+		uint8_t *result = NULL;
+		uint32_t resultSize = 0;
+		int status = -1;
+		if (type >= SERVER_COMPRESS && type <= SERVER_CHECK && (mode == SERVER_PATH || mode == SERVER_INLINE)) {
+			status = handleRequest(options, type, mode, data, size, &result, &resultSize);
+		}
+		else {
+			printf("ERROR: Unknown request %d (mode %d)\n", type, mode);
+		}
+		free(data);
+		uint64_t elapsed = currentMicroseconds() - start;
+
+		writeLittleIntData(header, 0, status == 0 ? 0 : 1);
+		writeLittleIntData(header, 4, elapsed > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)elapsed);
+		writeLittleIntData(header, 8, resultSize);
+		int sent = writeAll(connectionFd, header, MESSAGE_HEADER_SIZE) == 0 && writeAll(connectionFd, result, resultSize) == 0;
+		free(result);
+		if (!sent) {
+			return;
+		}
+	}
+}
+
+int runServer(const char *socketPath, const Job *options) {
+	struct sockaddr_un address;
+	if (makeAddress(socketPath, &address) != 0) {
+		return -1;
+	}
+
+	// A client going away shouldn't take the server with it
+	signal(SIGPIPE, SIG_IGN);
+	// Log lines show up as requests finish, even when the output goes to a file
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		puts("ERROR: Unable to create the socket");
+		return -1;
+	}
+	// Replace the socket left over from a previous server
+	unlink(socketPath);
+	if (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listenFd, 64) != 0) {
+		printf("ERROR: Unable to listen on %s\n", socketPath);
+		close(listenFd);
+		return -1;
+	}
+	printf("Listening on %s\n", socketPath);
+
+	// Every thread takes connections on its own, and keeps its compressor state between them
+#pragma omp parallel
+	{
+		while (1) {
+			int connectionFd = accept(listenFd, NULL, NULL);
+			if (connectionFd < 0) {
+				continue;
+			}
+			serveConnection(connectionFd, options);
+			close(connectionFd);
+		}
+	}
+
+	close(listenFd);
+	return 0;
+}
+
+int sendRequest(const char *socketPath, int type, int mode, const uint8_t *data, uint32_t size, uint8_t **result, uint32_t *resultSize, uint32_t *microseconds) {
+	struct sockaddr_un address;
+	if (makeAddress(socketPath, &address) != 0) {
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	int socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (socketFd < 0 || connect(socketFd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		printf("ERROR: Unable to connect to %s\n", socketPath);
+		if (socketFd >= 0) {
+			close(socketFd);
+		}
+		return -1;
+	}
+
+	uint8_t header[MESSAGE_HEADER_SIZE];
+	writeLittleIntData(header, 0, (uint32_t)type);
+	writeLittleIntData(header, 4, (uint32_t)mode);
+	writeLittleIntData(header, 8, size);
+	if (writeAll(socketFd, header, MESSAGE_HEADER_SIZE) != 0 || writeAll(socketFd, data, size) != 0 || readAll(socketFd, header, MESSAGE_HEADER_SIZE) != 0) {
+		printf("ERROR: Lost the connection to %s\n", socketPath);
+		close(socketFd);
+		return -1;
+	}
+
+	int status = readLittleIntData(header, 0) == 0 ? 0 : -1;
+	if (microseconds != NULL) {
+		*microseconds = readLittleIntData(header, 4);
+	}
+	uint32_t dataSize = readLittleIntData(header, 8);
+	uint8_t *received = (uint8_t *)malloc(sizeof(uint8_t) * ((size_t)dataSize + 1));
+	if (received == NULL || readAll(socketFd, received, dataSize) != 0) {
+		printf("ERROR: Lost the connection to %s\n", socketPath);
+		free(received);
+		close(socketFd);
+		return -1;
+	}
+	close(socketFd);
+
+	if (result != NULL) {
+		*result = received;
+		*resultSize = dataSize;
+	}
+	else {
+		free(received);
+	}
+	return status;
+}
+
+int runClient(const char *socketPath, Job *jobs, int count) {
+	int failures = 0;
+	for (int i = 0; i < count; i++) {
+		Job *job = &jobs[i];
+		int type = job->type == JOB_COMPRESS ? SERVER_COMPRESS : (job->type == JOB_CHECK ? SERVER_CHECK : (job->verify ? SERVER_VERIFY : SERVER_DECOMPRESS));
+		if (job->type == JOB_TRANSCODE) {
+			printf("ERROR: The server doesn't transcode: %s\n", job->filename);
+			job->failed = 1;
+			++failures;
+			continue;
+		}
+		if (job->type == JOB_ESTIMATE) {
+			printf("ERROR: The server doesn't estimate: %s\n", job->filename);
+			job->failed = 1;
+			++failures;
+			continue;
+		}
+		// A request only names the file, the server uses the options it was started with
+		// so options given here that would change the output are refused instead of dropped
+		if (job->dictionarySize > 0 || job->writeIndex || (job->type == JOB_COMPRESS &&
+			(job->verify || job->optimal || job->best || job->probeRatio > 0 || job->baseData != NULL))) {
+			printf("ERROR: Give --dict, --index, --verify, --optimal, --best, --probe and --base to the server, not the client: %s\n", job->filename);
+			job->failed = 1;
+			++failures;
+			continue;
+		}
+
+		// The server has its own working directory
+		char path[PATH_MAX];
+		if (realpath(job->filename, path) == NULL) {
+			printf("ERROR: File not found: %s\n", job->filename);
+			job->failed = 1;
+			++failures;
+			continue;
+		}
+
+		// Only a check gets data back, its checksum and size for the manifest
+		uint8_t *result = NULL;
+		uint32_t resultSize = 0;
+		uint32_t microseconds = 0;
+		if (sendRequest(socketPath, type, SERVER_PATH, (const uint8_t *)path, (uint32_t)strlen(path), &result, &resultSize, &microseconds) != 0) {
+			printf("ERROR: The server failed on %s\n", job->filename);
+			job->failed = 1;
+			++failures;
+		}
+		else if (type == SERVER_CHECK && resultSize != 8) {
+			printf("ERROR: The server didn't send a checksum for %s\n", job->filename);
+			job->failed = 1;
+			++failures;
+		}
+		else {
+			if (type == SERVER_CHECK) {
+				job->checksum = readLittleIntData(result, 0);
+				job->outputSize = readLittleIntData(result, 4);
+			}
+			printf("Finished %s (%u us)\n", job->filename, microseconds);
+		}
+		free(result);
+	}
+	return failures;
+}
+
+#else
+
+int runServer(const char *socketPath, const Job *options) {
+	puts("ERROR: The server needs Unix sockets, which aren't supported on Windows");
+	return -1;
+}
+
+int sendRequest(const char *socketPath, int type, int mode, const uint8_t *data, uint32_t size, uint8_t **result, uint32_t *resultSize, uint32_t *microseconds) {
+	puts("ERROR: The server needs Unix sockets, which aren't supported on Windows");
+	return -1;
+}
+
+int runClient(const char *socketPath, Job *jobs, int count) {
+	puts("ERROR: The server needs Unix sockets, which aren't supported on Windows");
+	return count;
+}
+
+#endif
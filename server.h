@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+
+#include "jobs.h"
+
+#define SERVER_COMPRESS 0
+#define SERVER_DECOMPRESS 1
+#define SERVER_VERIFY 2      // Decode a compressed file in memory and check it against its header
+#define SERVER_CHECK 3       // Decode a compressed file in memory and send back its CRC-32 and uncompressed size
+
+// A request names a file (the result is written next to it like on the command line)
+// or carries the data itself (the result is sent back)
+#define SERVER_PATH 0
+#define SERVER_INLINE 1
+
+// Answers requests on a Unix socket until the process is killed
+// Every thread runs its own worker, so each one keeps its compressor warm between requests
+// options holds the format, verify, window/dictionary and writeIndex settings used for every request
+// Returns -1 if the socket can't be set up (or on Windows, where it isn't supported)
+int runServer(const char *socketPath, const Job *options);
+
+// Sends one request to the server and waits for the answer
+// If result isn't NULL it gets the data sent back (free it), microseconds gets how long the server took
+// Returns 0 if the request succeeded, or -1 if it failed or the server can't be reached
+int sendRequest(const char *socketPath, int type, int mode, const uint8_t *data, uint32_t size, uint8_t **result, uint32_t *resultSize, uint32_t *microseconds);
+
+// Sends every job to the server as a file path (decompress jobs with verify set only get verified)
+// Jobs with options the server has to be started with (dictionary, index, compress options) fail instead
+// Check jobs get their checksum and uncompressed size from the server, failed jobs are marked failed
+// Returns the number of jobs that failed
+int runClient(const char *socketPath, Job *jobs, int count);
@@ -0,0 +1,370 @@
+#include "suffixarray.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define TYPE_L 0
+#define TYPE_S 1
+
+static int isLms(const uint8_t *types, int32_t i) {
+	return i > 0 && types[i] == TYPE_S && types[i - 1] == TYPE_L;
+}
+
+/*
+* Finds the start (or end) of every character's bucket in the suffix array
+*/
+static void getBuckets(const int32_t *s, int32_t n, int32_t k, int32_t *buckets, int end) {
+	memset(buckets, 0, sizeof(int32_t) * k);
+	for (int32_t i = 0; i < n; i++) {
+		buckets[s[i]]++;
+	}
+	int32_t sum = 0;
+	for (int32_t i = 0; i < k; i++) {
+		sum += buckets[i];
+		buckets[i] = end ? sum : sum - buckets[i];
+	}
+}
+
+/*
+* Sorts the L type suffixes from the sorted LMS suffixes, then the S type suffixes from those
+*/
+static void induceSort(const int32_t *s, int32_t *sa, const uint8_t *types, int32_t n, int32_t k, int32_t *buckets) {
+	getBuckets(s, n, k, buckets, 0);
+	for (int32_t i = 0; i < n; i++) {
+		int32_t j = sa[i] - 1;
+		if (sa[i] > 0 && types[j] == TYPE_L) {
+			sa[buckets[s[j]]++] = j;
+		}
+	}
+
+	getBuckets(s, n, k, buckets, 1);
+	for (int32_t i = n - 1; i >= 0; i--) {
+		int32_t j = sa[i] - 1;
+		if (sa[i] > 0 && types[j] == TYPE_S) {
+			sa[--buckets[s[j]]] = j;
+		}
+	}
+}
+
+/*
+* SA-IS on s[0..n), which has to end with a unique 0, using characters below k
+*/
+static int sais(const int32_t *s, int32_t *sa, int32_t n, int32_t k) {
+	uint8_t *types = (uint8_t *)malloc(sizeof(uint8_t) * n);
+	int32_t *buckets = (int32_t *)malloc(sizeof(int32_t) * k);
+	if (types == NULL || buckets == NULL) {
+		free(types);
+		free(buckets);
+		return -1;
+	}
+
+	// S type suffixes are smaller than the one after them
+	types[n - 1] = TYPE_S;
+	for (int32_t i = n - 2; i >= 0; i--) {
+		types[i] = (s[i] < s[i + 1] || (s[i] == s[i + 1] && types[i + 1] == TYPE_S)) ? TYPE_S : TYPE_L;
+	}
+
+	// Sort the LMS substrings by putting them at the ends of their buckets and inducing
+	getBuckets(s, n, k, buckets, 1);
+	for (int32_t i = 0; i < n; i++) {
+		sa[i] = -1;
+	}
+	for (int32_t i = 1; i < n; i++) {
+		if (isLms(types, i)) {
+			sa[--buckets[s[i]]] = i;
+		}
+	}
+	induceSort(s, sa, types, n, k, buckets);
+
+	// Move the sorted LMS substrings to the front
+	int32_t n1 = 0;
+	for (int32_t i = 0; i < n; i++) {
+		if (isLms(types, sa[i])) {
+			sa[n1++] = sa[i];
+		}
+	}
+
+	// Name them, equal substrings get the same name
+	for (int32_t i = n1; i < n; i++) {
+		sa[i] = -1;
+	}
+	int32_t name = 0;
+	int32_t previous = -1;
+	for (int32_t i = 0; i < n1; i++) {
+		int32_t position = sa[i];
+		int different = 0;
+		for (int32_t d = 0; d < n; d++) {
+			if (previous == -1 || s[position + d] != s[previous + d] || types[position + d] != types[previous + d]) {
+				different = 1;
+				break;
+			}
+			else if (d > 0 && (isLms(types, position + d) || isLms(types, previous + d))) {
+				break;
+			}
+		}
+		if (different) {
+			++name;
+			previous = position;
+		}
+		// LMS positions are at least 2 apart, so this doesn't collide
+		sa[n1 + position / 2] = name - 1;
+	}
+	for (int32_t i = n - 1, j = n - 1; i >= n1; i--) {
+		if (sa[i] >= 0) {
+			sa[j--] = sa[i];
+		}
+	}
+
+	// Sort the LMS suffixes by their names (recursing if some names repeat)
+	int32_t *s1 = sa + n - n1;
+	if (name < n1) {
+		if (sais(s1, sa, n1, name) != 0) {
+			free(types);
+			free(buckets);
+			return -1;
+		}
+	}
+	else {
+		for (int32_t i = 0; i < n1; i++) {
+			sa[s1[i]] = i;
+		}
+	}
+
+	// Put the sorted LMS suffixes at the ends of their buckets and induce the rest
+	getBuckets(s, n, k, buckets, 1);
+	for (int32_t i = 1, j = 0; i < n; i++) {
+		if (isLms(types, i)) {
+			s1[j++] = i;
+		}
+	}
+	for (int32_t i = 0; i < n1; i++) {
+		sa[i] = s1[sa[i]];
+	}
+	for (int32_t i = n1; i < n; i++) {
+		sa[i] = -1;
+	}
+	for (int32_t i = n1 - 1; i >= 0; i--) {
+		int32_t j = sa[i];
+		sa[i] = -1;
+		sa[--buckets[s[j]]] = j;
+	}
+	induceSort(s, sa, types, n, k, buckets);
+
+	free(types);
+	free(buckets);
+	return 0;
+}
+
+int32_t *buildSuffixArray(const uint8_t *data, uint32_t size) {
+	// Shift every byte up by 1 so 0 can end the string
+	int32_t n = (int32_t)size + 1;
+	int32_t *s = (int32_t *)malloc(sizeof(int32_t) * n);
+	int32_t *sa = (int32_t *)malloc(sizeof(int32_t) * n);
+	if (s == NULL || sa == NULL) {
+		free(s);
+		free(sa);
+		return NULL;
+	}
+	for (uint32_t i = 0; i < size; i++) {
+		s[i] = data[i] + 1;
+	}
+	s[size] = 0;
+
+	int result = sais(s, sa, n, 257);
+	free(s);
+	if (result != 0) {
+		free(sa);
+		return NULL;
+	}
+
+	// The end of the string always sorts first
+	memmove(sa, sa + 1, sizeof(int32_t) * size);
+	return sa;
+}
+
+static int highestBit(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+}
+
+static int lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+// Set of suffix array ranks: a bit per rank, then a bit per word of the level below that has any set
+// so finding the closest rank on either side only looks at one word per level
+#define RANK_SET_MAX_LEVELS 6
+typedef struct {
+	uint64_t *levels[RANK_SET_MAX_LEVELS];
+	int levelCount;
+}RankSet;
+
+static int createRankSet(RankSet *set, uint32_t size) {
+	int64_t count = ((int64_t)size + 63) >> 6;
+	set->levelCount = 0;
+	// Up to a level that is a single word
+	while (1) {
+		set->levels[set->levelCount++] = (uint64_t *)calloc(count + 1, sizeof(uint64_t));
+		if (set->levels[set->levelCount - 1] == NULL) {
+			return -1;
+		}
+		if (count <= 1) {
+			return 0;
+		}
+		count = (count + 63) >> 6;
+	}
+}
+
+static void freeRankSet(RankSet *set) {
+	for (int level = 0; level < set->levelCount; level++) {
+		free(set->levels[level]);
+	}
+	set->levelCount = 0;
+}
+
+static void addRank(RankSet *set, int64_t rank) {
+	for (int level = 0; level < set->levelCount; level++) {
+		set->levels[level][rank >> 6] |= 1ull << (rank & 63);
+		rank >>= 6;
+	}
+}
+
+static void removeRank(RankSet *set, int64_t rank) {
+	for (int level = 0; level < set->levelCount; level++) {
+		set->levels[level][rank >> 6] &= ~(1ull << (rank & 63));
+		// The levels above only change if the word is now empty
+		if (set->levels[level][rank >> 6] != 0) {
+			break;
+		}
+		rank >>= 6;
+	}
+}
+
+/*
+* Finds the largest rank in the set below rank, or -1 if there isn't one
+*/
+static int64_t previousRank(const RankSet *set, int64_t rank) {
+	// Go up until a word has something before the position
+	int level = 0;
+	while (1) {
+		if (level == set->levelCount) {
+			return -1;
+		}
+		uint64_t bits = set->levels[level][rank >> 6] & ((1ull << (rank & 63)) - 1);
+		if (bits != 0) {
+			rank = ((rank >> 6) << 6) + highestBit(bits);
+			break;
+		}
+		rank >>= 6;
+		++level;
+	}
+
+	// Then back down taking the last one every time
+	while (level-- > 0) {
+		rank = (rank << 6) + highestBit(set->levels[level][rank]);
+	}
+	return rank;
+}
+
+/*
+* Finds the smallest rank in the set above rank, or -1 if there isn't one
+*/
+static int64_t nextRank(const RankSet *set, int64_t rank) {
+	// Go up until a word has something after the position
+	int level = 0;
+	while (1) {
+		if (level == set->levelCount) {
+			return -1;
+		}
+		uint64_t bits = (rank & 63) == 63 ? 0 : set->levels[level][rank >> 6] & ~((2ull << (rank & 63)) - 1);
+		if (bits != 0) {
+			rank = ((rank >> 6) << 6) + lowestBit(bits);
+			break;
+		}
+		rank >>= 6;
+		++level;
+	}
+
+	// Then back down taking the first one every time
+	while (level-- > 0) {
+		rank = (rank << 6) + lowestBit(set->levels[level][rank]);
+	}
+	return rank;
+}
+
+int findLongestMatches(const uint8_t *data, uint32_t size, uint32_t start, uint32_t maxDistance, uint32_t maxLength, uint8_t *lengths, uint32_t *distances) {
+	int32_t *sa = buildSuffixArray(data, size);
+	if (sa == NULL) {
+		return -1;
+	}
+	// Turn it around into the rank of every position
+	int32_t *ranks = (int32_t *)malloc(sizeof(int32_t) * ((size_t)size + 1));
+	RankSet set;
+	set.levelCount = 0;
+	if (ranks == NULL || createRankSet(&set, size) != 0) {
+		free(sa);
+		free(ranks);
+		freeRankSet(&set);
+		return -1;
+	}
+	for (uint32_t i = 0; i < size; i++) {
+		ranks[sa[i]] = (int32_t)i;
+	}
+
+	// The set holds the ranks of the positions in the window before the current one
+	// The longest match is with the closest rank in the set on either side, since
+	// the common prefix only gets shorter further away in the suffix array
+	uint32_t windowStart = start > maxDistance ? start - maxDistance : 0;
+	for (uint32_t i = windowStart; i < start; i++) {
+		addRank(&set, ranks[i]);
+	}
+	for (uint32_t position = start; position < size; position++) {
+		uint32_t limit = size - position < maxLength ? size - position : maxLength;
+		uint32_t bestLength = 0;
+		uint32_t bestDistance = 0;
+		int64_t neighbors[2] = { previousRank(&set, ranks[position]), nextRank(&set, ranks[position]) };
+		for (int side = 0; side < 2; side++) {
+			if (neighbors[side] < 0) {
+				continue;
+			}
+			uint32_t matchPosition = (uint32_t)sa[neighbors[side]];
+			uint32_t length = 0;
+			while (length < limit && data[matchPosition + length] == data[position + length]) {
+				++length;
+			}
+			if (length > bestLength) {
+				bestLength = length;
+				bestDistance = position - matchPosition;
+			}
+		}
+		lengths[position - start] = (uint8_t)bestLength;
+		distances[position - start] = bestDistance;
+
+		// Slide the window forward
+		addRank(&set, ranks[position]);
+		if (position >= maxDistance) {
+			removeRank(&set, ranks[position - maxDistance]);
+		}
+	}
+
+	free(sa);
+	free(ranks);
+	freeRankSet(&set);
+	return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+// Builds the suffix array of data (with SA-IS, in linear time)
+// Returns the start of every suffix in sorted order (free it), or NULL if out of memory
+int32_t *buildSuffixArray(const uint8_t *data, uint32_t size);
+
+// For every position from start on, finds the longest match (up to maxLength) starting 1 to maxDistance bytes before it
+// lengths[i] and distances[i] are for position start + i (a length of 0 means no earlier data matches)
+// Matches can overlap the position, but never run past the end of the data
+// Returns 0, or -1 if out of memory
+int findLongestMatches(const uint8_t *data, uint32_t size, uint32_t start, uint32_t maxDistance, uint32_t maxLength, uint8_t *lengths, uint32_t *distances);